@@ -0,0 +1,123 @@
+// Micro-benchmark of the seam cost: per-edge computeWeight against the row kernels of seamCost.h,
+// and of the graph construction and maxflow on one thread against parallelThreads() threads.
+// Usage: ./SeamCostBench [image1 image2] [lambda]
+// Without images, two random 2000x2000 images are used. Both images are fully overlapped.
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <iostream>
+#include <stdlib.h>
+
+#include "photomontage.h"
+#include "seamCost.h"
+#include "parallel.h"
+#include "parallelGraph.h"
+
+using namespace std;
+
+double elapsed_ms(int64 t0){
+    return ((double)getTickCount()-t0)*1000./getTickFrequency();
+}
+
+int main(int argc, char** argv){
+    Image<Vec3b> I1, I2;
+    int lambda = 5;
+    const int max_lambda = 10;
+    if(argc>=3){
+        I1 = imread(argv[1]);
+        I2 = imread(argv[2]);
+        if(argc>=4) lambda = atoi(argv[3]);
+    }
+    else{
+        I1 = Image<Vec3b>(2000, 2000, CV_8UC3);
+        I2 = Image<Vec3b>(2000, 2000, CV_8UC3);
+        randu(I1, Scalar::all(0), Scalar::all(256));
+        randu(I2, Scalar::all(0), Scalar::all(256));
+    }
+    if(I1.empty() || I2.empty()){
+        cout << "could not read the images" << endl;
+        return -1;
+    }
+    Rectangle overlap;
+    overlap.p1 = Point(0,0);
+    overlap.p2 = Point(min(I1.width(),I2.width()), min(I1.height(),I2.height()));
+    int w = overlap.p2.x, h = overlap.p2.y;
+    Point offset(0,0);
+
+    Image<float> G1(I1.width(), I1.height(), CV_32F), G2(I2.width(), I2.height(), CV_32F);
+    computeGradient(I1, G1, false);
+    computeGradient(I2, G2, false);
+    cout << w << "x" << h << " overlap, lambda=" << lambda << "/" << max_lambda << ", kernel: " << seamCostKernel() << endl;
+
+    // reference: one computeWeight per edge
+    int64 t0 = getTickCount();
+    Image<float> reference(w-1, h, CV_32F);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w-1; x++)
+            reference(x,y) = (float)computeWeight(x,y,x+1,y,lambda,max_lambda,I1,I2,G1,G2,offset,offset);
+    double t_reference = elapsed_ms(t0);
+
+    float wc = float(max_lambda-lambda)/max_lambda, wg = float(lambda)/max_lambda;
+    Image<float> cost(w, h, CV_32F);
+    const int runs = 10;
+    t0 = getTickCount();
+    for(int r=0; r<runs; r++)
+        for(int y=0; y<h; y++)
+            seamCostRowScalar(I1.ptr<Vec3b>(y), I2.ptr<Vec3b>(y), G1.ptr<float>(y), G2.ptr<float>(y), wc, wg, cost.ptr<float>(y), w);
+    double t_scalar = elapsed_ms(t0)/runs;
+    t0 = getTickCount();
+    for(int r=0; r<runs; r++)
+        for(int y=0; y<h; y++)
+            seamCostRow(I1.ptr<Vec3b>(y), I2.ptr<Vec3b>(y), G1.ptr<float>(y), G2.ptr<float>(y), wc, wg, cost.ptr<float>(y), w);
+    double t_vector = elapsed_ms(t0)/runs;
+
+    Image<float> horizontal, vertical;
+    t0 = getTickCount();
+    for(int r=0; r<runs; r++)
+        computeSeamCosts(overlap, I1, I2, G1, G2, offset, offset, lambda, max_lambda, horizontal, vertical);
+    double t_planes = elapsed_ms(t0)/runs;
+
+    double max_error = norm(horizontal, reference, NORM_INF);
+    cout << "computeWeight per edge:   " << t_reference << " ms (horizontal edges only)" << endl;
+    cout << "seamCostRowScalar:        " << t_scalar << " ms" << endl;
+    cout << "seamCostRow (" << seamCostKernel() << "):      " << t_vector << " ms, x" << t_scalar/t_vector << " over scalar" << endl;
+    cout << "computeSeamCosts:         " << t_planes << " ms (both directions)" << endl;
+    cout << "max difference with computeWeight: " << max_error << endl;
+
+    // graph of the whole overlap, only the first and last columns fixed
+    Image<uchar> constraints = overlapConstraints(overlap, true, true, 1, 1);
+    Image<int> nodes;
+    int node_num = numberFreePoints(constraints, nodes);
+    int threads = parallelThreads();
+    double t_build[2];
+    for(int k=0; k<2; k++){
+        setParallelThreads(k==0 ? 1 : threads);
+        t0 = getTickCount();
+        Graph<float,float,float> G = createGraphFromRectangle<float,float,float>(overlap, constraints, nodes, node_num, horizontal, vertical);
+        t_build[k] = elapsed_ms(t0);
+        if(k==1)
+            cout << G.get_node_num() << " nodes, " << G.get_arc_num()/2 << " edges" << endl;
+    }
+    cout << "createGraphFromRectangle: " << t_build[0] << " ms on 1 thread, " << t_build[1] << " ms on " << threads << " threads" << endl;
+
+    // both solvers on the same graph, their flows must be equal
+    Graph<double,double,double> B = createGraphFromRectangle<double,double,double>(overlap, constraints, nodes, node_num, horizontal, vertical);
+    Graph<double,double,double> P = createGraphFromRectangle<double,double,double>(overlap, constraints, nodes, node_num, horizontal, vertical);
+    t0 = getTickCount();
+    double flow_bk = B.maxflow();
+    double t_bk = elapsed_ms(t0);
+    t0 = getTickCount();
+    double flow_parallel = parallelMaxflow(P);
+    double t_parallel = elapsed_ms(t0);
+    cout << "maxflow BK:               " << t_bk << " ms, flow " << flow_bk << endl;
+    cout << "maxflow parallel:         " << t_parallel << " ms on " << threads << " threads, flow " << flow_parallel << endl;
+
+    t0 = getTickCount();
+    GridGraph<double,double,double> R = createGridGraphFromRectangle<double,double,double>(overlap, constraints, horizontal, vertical);
+    double t_grid_build = elapsed_ms(t0);
+    t0 = getTickCount();
+    double flow_grid = R.maxflow();
+    double t_grid = elapsed_ms(t0);
+    cout << "createGridGraphFromRectangle: " << t_grid_build << " ms, " << R.memory()/1000000 << " MB" << endl;
+    cout << "maxflow grid:             " << t_grid << " ms, flow " << flow_grid << endl;
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include "blend.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// weight of the montage colors in the Poisson equation
+static const float anchor_weight = 1e-4f;
+// the coarsest level has less than this many points on a side
+static const int coarsest_size = 32;
+// iterations of the conjugate gradients at the finest level and at the coarsest one, and relative residual
+static const int fine_iterations = 30, coarse_iterations = 300;
+static const double tolerance = 1e-3;
+
+// sum over bands of rows of f(y0, y1)
+template <typename F> static double parallelSum(int h, F f){
+    int bands = max(1, min(h, parallelThreads()));
+    vector<double> sums(bands, 0);
+    parallelFor(bands, [&](int b) { sums[b] = f(b*h/bands, (b+1)*h/bands); });
+    double s = 0;
+    for(int b=0; b<bands; b++)
+        s += sums[b];
+    return s;
+}
+
+template <typename F> static void parallelRows(int h, F f){
+    int bands = max(1, min(h, parallelThreads()));
+    parallelFor(bands, [&](int b) { f(b*h/bands, (b+1)*h/bands); });
+}
+
+// Poisson problem of one channel: find f minimizing the sum over the edges of (f(q)-f(p)-g(p,q))^2 plus
+// anchor_weight*(f-m)^2, gx(x,y) being the target of f(x+1,y)-f(x,y) and gy(x,y) the one of f(x,y+1)-f(x,y)
+struct PoissonLevel {
+    Image<float> m, gx, gy;
+    int width() const { return m.width(); }
+    int height() const { return m.height(); }
+};
+
+// y = A x for the normal equations of the problem
+static void applyPoisson(const Image<float>& x, Image<float>& y){
+    int w = x.width(), h = x.height();
+    parallelRows(h, [&](int y0, int y1) {
+        for(int j=y0; j<y1; j++){
+            const float* r = x.ptr<float>(j);
+            const float* up = j>0 ? x.ptr<float>(j-1) : NULL;
+            const float* down = j<h-1 ? x.ptr<float>(j+1) : NULL;
+            float* out = y.ptr<float>(j);
+            for(int i=0; i<w; i++){
+                float v = anchor_weight*r[i];
+                if(i>0) v += r[i]-r[i-1];
+                if(i<w-1) v += r[i]-r[i+1];
+                if(up) v += r[i]-up[i];
+                if(down) v += r[i]-down[i];
+                out[i] = v;
+            }
+        }
+    });
+}
+
+static double dot(const Image<float>& a, const Image<float>& b){
+    return parallelSum(a.height(), [&](int y0, int y1) {
+        double s = 0;
+        for(int j=y0; j<y1; j++){
+            const float* pa = a.ptr<float>(j);
+            const float* pb = b.ptr<float>(j);
+            for(int i=0; i<a.width(); i++)
+                s += double(pa[i])*pb[i];
+        }
+        return s;
+    });
+}
+
+// preconditioned conjugate gradients from the initial guess f
+static void solvePoisson(const PoissonLevel& L, Image<float>& f, int max_iterations){
+    int w = L.width(), h = L.height();
+    // right-hand side and diagonal of the normal equations
+    Image<float> b(w, h, CV_32F), diag(w, h, CV_32F);
+    parallelRows(h, [&](int y0, int y1) {
+        for(int j=y0; j<y1; j++)
+            for(int i=0; i<w; i++){
+                float v = anchor_weight*L.m(i,j), d = anchor_weight;
+                if(i>0){ v += L.gx(i-1,j); d++; }
+                if(i<w-1){ v -= L.gx(i,j); d++; }
+                if(j>0){ v += L.gy(i,j-1); d++; }
+                if(j<h-1){ v -= L.gy(i,j); d++; }
+                b(i,j) = v;
+                diag(i,j) = d;
+            }
+    });
+    Image<float> r(w, h, CV_32F), z(w, h, CV_32F), p(w, h, CV_32F), q(w, h, CV_32F);
+    applyPoisson(f, q);
+    subtract(b, q, r);
+    divide(r, diag, z);
+    z.copyTo(p);
+    double rz = dot(r, z), norm_b = sqrt(dot(b, b));
+    for(int k=0; k<max_iterations && sqrt(dot(r, r))>tolerance*norm_b; k++){
+        applyPoisson(p, q);
+        double alpha = rz/dot(p, q);
+        parallelRows(h, [&](int y0, int y1) {
+            for(int j=y0; j<y1; j++){
+                float* pf = f.ptr<float>(j);
+                float* pr = r.ptr<float>(j);
+                float* pz = z.ptr<float>(j);
+                const float* pp = p.ptr<float>(j);
+                const float* pq = q.ptr<float>(j);
+                const float* pd = diag.ptr<float>(j);
+                for(int i=0; i<w; i++){
+                    pf[i] += float(alpha)*pp[i];
+                    pr[i] -= float(alpha)*pq[i];
+                    pz[i] = pr[i]/pd[i];
+                }
+            }
+        });
+        double rz_next = dot(r, z), beta = rz_next/rz;
+        rz = rz_next;
+        parallelRows(h, [&](int y0, int y1) {
+            for(int j=y0; j<y1; j++){
+                float* pp = p.ptr<float>(j);
+                const float* pz = z.ptr<float>(j);
+                for(int i=0; i<w; i++)
+                    pp[i] = pz[i]+float(beta)*pp[i];
+            }
+        });
+    }
+}
+
+// the same problem at half resolution: block means of m, and the differences between the means of neighbouring
+// blocks implied by the target gradients
+static PoissonLevel coarseLevel(const PoissonLevel& L){
+    int w = L.width(), h = L.height(), cw = (w+1)/2, ch = (h+1)/2;
+    PoissonLevel C;
+    resize(L.m, C.m, Size(cw, ch), 0, 0, INTER_AREA);
+    C.gx = Image<float>(max(cw-1,0), ch, CV_32F);
+    C.gy = Image<float>(cw, max(ch-1,0), CV_32F);
+    // mean over the lines of the block of (gx(2X)/2 + gx(2X+1) + gx(2X+2)/2), with the edges that exist
+    for(int Y=0; Y<ch; Y++)
+        for(int X=0; X<cw-1; X++){
+            double s = 0;
+            int n = 0;
+            for(int y=2*Y; y<min(2*Y+2, h); y++, n++)
+                s += 0.5*L.gx(2*X,y) + L.gx(2*X+1,y) + (2*X+2<w-1 ? 0.5*L.gx(2*X+2,y) : 0.5*L.gx(2*X+1,y));
+            C.gx(X,Y) = float(s/n);
+        }
+    for(int Y=0; Y<ch-1; Y++)
+        for(int X=0; X<cw; X++){
+            double s = 0;
+            int n = 0;
+            for(int x=2*X; x<min(2*X+2, w); x++, n++)
+                s += 0.5*L.gy(x,2*Y) + L.gy(x,2*Y+1) + (2*Y+2<h-1 ? 0.5*L.gy(x,2*Y+2) : 0.5*L.gy(x,2*Y+1));
+            C.gy(X,Y) = float(s/n);
+        }
+    return C;
+}
+
+// cascadic solve: the correction f-m found at half resolution, upsampled, is the initial guess
+static Image<float> cascadicSolve(const PoissonLevel& L){
+    Image<float> f;
+    if(min(L.width(), L.height())<coarsest_size){
+        f = L.m.clone();
+        solvePoisson(L, f, coarse_iterations);
+        return f;
+    }
+    PoissonLevel C = coarseLevel(L);
+    Image<float> fc = cascadicSolve(C);
+    Mat coarse_correction, correction;
+    subtract(fc, C.m, coarse_correction);
+    resize(coarse_correction, correction, L.m.size(), 0, 0, INTER_LINEAR);
+    f = Image<float>(L.width(), L.height(), CV_32F);
+    add(L.m, correction, f);
+    solvePoisson(L, f, fine_iterations);
+    return f;
+}
+
+void poissonBlend(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point offset1, Point offset2, const Rectangle& rec, const Image<float>& cut, Image<Vec3b>& montage){
+    int w = montage.width(), h = montage.height();
+    if(w<2 || h<2)
+        return;
+    Rect r1(offset1.x-rec.p1.x, offset1.y-rec.p1.y, I1color.width(), I1color.height());
+    Rect r2(offset2.x-rec.p1.x, offset2.y-rec.p1.y, I2color.width(), I2color.height());
+    Mat planes1[3], planes2[3], montage_planes[3];
+    split(I1color, planes1);
+    split(I2color, planes2);
+    split(montage, montage_planes);
+    for(int c=0; c<3; c++){
+        // value of image k at the point p of the montage, which it must cover
+        auto value = [&](int k, Point p) {
+            return k==1 ? float(planes1[c].at<uchar>(p.y-r1.y, p.x-r1.x)) : float(planes2[c].at<uchar>(p.y-r2.y, p.x-r2.x));
+        };
+        // target of f(q)-f(p) for neighbours p and q
+        auto target = [&](Point p, Point q) {
+            int kp = cut(p)>0.5f ? 1 : 2, kq = cut(q)>0.5f ? 1 : 2;
+            if(kp==kq)
+                return value(kp,q)-value(kp,p);
+            float s = 0;
+            int n = 0;
+            for(int k=1; k<=2; k++){
+                const Rect& r = (k==1) ? r1 : r2;
+                if(r.contains(p) && r.contains(q)){
+                    s += value(k,q)-value(k,p);
+                    n++;
+                }
+            }
+            return n ? s/n : 0.f;
+        };
+        PoissonLevel L;
+        montage_planes[c].convertTo(L.m, CV_32F);
+        L.gx = Image<float>(w-1, h, CV_32F);
+        L.gy = Image<float>(w, h-1, CV_32F);
+        parallelRows(h, [&](int y0, int y1) {
+            for(int y=y0; y<y1; y++)
+                for(int x=0; x<w; x++){
+                    if(x<w-1) L.gx(x,y) = target(Point(x,y), Point(x+1,y));
+                    if(y<h-1) L.gy(x,y) = target(Point(x,y), Point(x,y+1));
+                }
+        });
+        Image<float> f = cascadicSolve(L);
+        f.convertTo(montage_planes[c], CV_8U);
+    }
+    merge(montage_planes, 3, montage);
+}
+
+// lines of the strips of multibandBlend()
+static const int blend_strip = 64;
+
+// Laplacian pyramid of I with levels levels over the residual Gaussian level
+static void laplacianPyramid(const Mat& I, int levels, vector<Mat>& L){
+    buildPyramid(I, L, levels);
+    for(int k=0; k<levels; k++){
+        Mat up;
+        pyrUp(L[k+1], up, L[k].size());
+        L[k] -= up;
+    }
+}
+
+void multibandBlend(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point offset1, Point offset2, const Rectangle& rec, const Image<float>& cut, int type, int band, Image<Vec3b>& montage){
+    int w = montage.width(), h = montage.height();
+    band = max(band, 1);
+    Rect r1(offset1.x-rec.p1.x, offset1.y-rec.p1.y, I1color.width(), I1color.height());
+    Rect r2(offset2.x-rec.p1.x, offset2.y-rec.p1.y, I2color.width(), I2color.height());
+    Mat seam = Mat::zeros(h, w, CV_8U);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++)
+            if((x<w-1 && cut(x,y)!=cut(x+1,y)) || (y<h-1 && cut(x,y)!=cut(x,y+1)))
+                seam.at<uchar>(y,x) = 255;
+    Mat near;
+    dilate(seam, near, getStructuringElement(MORPH_RECT, Size(2*band+1, 2*band+1)));
+    // the weights of the coarsest level spread about 4<<levels points from the seam
+    int levels = 1;
+    while((8<<levels)<=band)
+        levels++;
+
+    int length = (type==1) ? h : w, across = (type==1) ? w : h;
+    int strips = (length+blend_strip-1)/blend_strip;
+    // a strip reads the images only, and writes its own lines of montage
+    parallelFor(strips, [&](int s) {
+        int s0 = s*blend_strip, s1 = min(s0+blend_strip, length);
+        auto point = [&](int line, int c) { return (type==1) ? Point(c, line) : Point(line, c); };
+        int lo = across, hi = -1;
+        for(int l=s0; l<s1; l++)
+            for(int c=0; c<across; c++)
+                if(near.at<uchar>(point(l,c))){
+                    lo = min(lo, c);
+                    hi = max(hi, c);
+                }
+        if(hi<0)
+            return;
+        int a = max(s0-band, 0), b = min(s1+band, length);
+        lo = max(lo-band, 0);
+        hi = min(hi+band+1, across);
+        Rect roi = (type==1) ? Rect(lo, a, hi-lo, b-a) : Rect(a, lo, b-a, hi-lo);
+
+        // each image where it covers the point, the other one elsewhere
+        Mat A(roi.size(), CV_32FC3), B(roi.size(), CV_32FC3), W(roi.size(), CV_32F);
+        for(int y=0; y<roi.height; y++)
+            for(int x=0; x<roi.width; x++){
+                Point q = roi.tl()+Point(x,y);
+                bool in1 = r1.contains(q), in2 = r2.contains(q);
+                Vec3b v1 = in1 ? I1color(q.x-r1.x, q.y-r1.y) : I2color(q.x-r2.x, q.y-r2.y);
+                Vec3b v2 = in2 ? I2color(q.x-r2.x, q.y-r2.y) : v1;
+                A.at<Vec3f>(y,x) = Vec3f(v1[0], v1[1], v1[2]);
+                B.at<Vec3f>(y,x) = Vec3f(v2[0], v2[1], v2[2]);
+                W.at<float>(y,x) = cut(q);
+            }
+        vector<Mat> LA, LB, GW;
+        laplacianPyramid(A, levels, LA);
+        laplacianPyramid(B, levels, LB);
+        buildPyramid(W, GW, levels);
+
+        Mat result;
+        for(int k=levels; k>=0; k--){
+            Mat weights, blended;
+            Mat channels[3] = {GW[k], GW[k], GW[k]};
+            merge(channels, 3, weights);
+            blended = LB[k] + weights.mul(LA[k]-LB[k]);
+            if(k==levels)
+                result = blended;
+            else{
+                Mat up;
+                pyrUp(result, up, blended.size());
+                result = up+blended;
+            }
+        }
+
+        for(int y=0; y<roi.height; y++)
+            for(int x=0; x<roi.width; x++){
+                Point q = roi.tl()+Point(x,y);
+                int line = (type==1) ? q.y : q.x;
+                if(line>=s0 && line<s1 && near.at<uchar>(q)){
+                    const Vec3f& v = result.at<Vec3f>(y,x);
+                    montage(q.x,q.y) = Vec3b(saturate_cast<uchar>(v[0]), saturate_cast<uchar>(v[1]), saturate_cast<uchar>(v[2]));
+                }
+            }
+    });
+}
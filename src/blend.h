@@ -0,0 +1,23 @@
+#pragma once
+
+#include "image.h"
+#include "rectangleOverlap.h"
+
+// Gradient-domain blending of a montage: montage (the rectangle rec of the final image, as given by photomontage)
+// is replaced by the image whose gradients are closest to the ones of the images the points come from, so that a
+// difference of exposure between the images is spread over the whole montage instead of showing at the seam.
+// cut is 1 where a point comes from I1color. Between two points from the same image the target gradient is the one
+// of that image; across the seam it is the mean of the images covering both points. A small weight keeps the colors
+// close to the montage, which fixes the constant of the Poisson equation.
+// The equation is solved for each channel by conjugate gradients preconditioned by the diagonal, in parallel over
+// bands of rows, starting from the solution of the same problem at half resolution (cascadic multigrid): a few
+// iterations per level are enough, so the cost stays about linear in the number of points.
+void poissonBlend(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point offset1, Point offset2, const Rectangle& rec, const Image<float>& cut, Image<Vec3b>& montage);
+
+// Multiband blending of a montage, much cheaper than poissonBlend(): near the seam, montage is replaced by the sum
+// over the levels of a Laplacian pyramid of both images weighted by a Gaussian pyramid of cut, so that low
+// frequencies are mixed over a wide area and details over a narrow one (Burt and Adelson).
+// Only the points closer than band to the seam change. The pyramids are built over rectangles that cover these points
+// for strips of 64 lines along the seam (rows for type 1, columns for type 2), in parallel, with as many levels as fit
+// in band. montage is written in place.
+void multibandBlend(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point offset1, Point offset2, const Rectangle& rec, const Image<float>& cut, int type, int band, Image<Vec3b>& montage);
@@ -2,16 +2,23 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
-#include <limits>
+#include <cmath>
 #include <string> 
+#include <vector>
 #include <stdlib.h>
 
-#include "maxflow/graph.h"
-#include "image.h"
-#include "rectangleOverlap.h"
-
-#define INF numeric_limits<double>::max()/100
+#include "photomontage.h"
+#include "incrementalMontage.h"
+#include "multiMontage.h"
+#include "tiledMontage.h"
+#include "registration.h"
+#include "offsetSearch.h"
+#include "textureSynthesis.h"
+#include "maskMontage.h"
+#include "parallel.h"
+#include "graphPool.h"
 
 using namespace std;
 
@@ -20,211 +27,49 @@ using namespace std;
 #define debug(x) {cout << #x << " " << x << endl;}
 #endif
 
-//calculate the total gradient of the image J_0 and store it in G
-void computeGradient(const Image<Vec3b>& J_0, Image<float>& G, bool blur_image)
-{
-    int m = J_0.width(), n = J_0.height();
-
-    Mat J;
-    if(blur_image)
-        GaussianBlur( J_0, J, Size(3,3), 0, 0, BORDER_DEFAULT );
-    else
-        J = J_0;
-
-    Image<float> I_0(m,n,CV_32F);
-    cvtColor(J,I_0,CV_BGR2GRAY);
-
-    int scale = 1;
-    int delta = 0;
-    int ddepth = CV_16S;
-
-    /// Generate grad_x and grad_y
-    Mat grad, grad_x, grad_y;
-    Mat abs_grad_x, abs_grad_y;
-
-    /// Gradient X
-    //Scharr( I_0, grad_x, ddepth, 1, 0, scale, delta, BORDER_DEFAULT );
-    Sobel(I_0, grad_x, ddepth, 1, 0, 3, scale, delta, BORDER_DEFAULT );
-    convertScaleAbs( grad_x, abs_grad_x );
-
-    /// Gradient Y
-    //Scharr( I_0, grad_y, ddepth, 0, 1, scale, delta, BORDER_DEFAULT );
-    Sobel( I_0, grad_y, ddepth, 0, 1, 3, scale, delta, BORDER_DEFAULT );
-    convertScaleAbs( grad_y, abs_grad_y );
-
-    /// Total Gradient (approximate)
-    addWeighted( abs_grad_x, 0.5, abs_grad_y, 0.5, 0, grad );
-    for(int i=0; i<m; i++)
-        for(int j=0; j<n; j++){
-            //cout << "i,j="<<i<<","<<j<<", m,n="<<m<<","<<n<<endl;
-            if(isnan(grad.at<float>(j,i)))
-                G(i,j)=0;
-            else
-                G(i,j)=grad.at<float>(j,i);
-        }
-}
-
-// computeWeight(i,j,i+1,j,lambda,max_lambda,I1color,I2color,G1,G2offset1,offset2)
-// computes the weight of the edge connecting points (i1,j1) and (i2,j2) in the final image based on their values on coloured images I1 and I2.
-// Consists of a weighted sum of a norm computed using the BGR matrices and a norm computed the matrices of gradients. 
-double computeBGRWeight(int i1, int j1, int i2, int j2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point& offset1, Point& offset2){
-    Scalar p1I1(I1color(i1-offset1.x,j1-offset1.y));
-    Scalar p1I2(I2color(i1-offset2.x,j1-offset2.y));
-    Scalar p2I1(I1color(i2-offset1.x,j2-offset1.y));
-    Scalar p2I2(I2color(i2-offset2.x,j2-offset2.y));
-    return norm(p1I1, p1I2) + norm(p2I1, p2I2);
-}
-
-double computeGradientWeight(int i1, int j1, int i2, int j2, const Image<float>&G1, const Image<float>&G2, Point& offset1, Point& offset2){
-    double p1I1 = G1(i1-offset1.x,j1-offset1.y);
-    double p1I2 = G2(i1-offset2.x,j1-offset2.y);
-    double p2I1 = G1(i2-offset1.x,j2-offset1.y);
-    double p2I2 = G2(i2-offset2.x,j2-offset2.y);
-    //cout << "i1,j1,i2,j2="<<i1<<","<<j1<<","<<i2<<","<<j2<<endl;
-    //cout << "offset1"<<offset1<<",offset2"<<offset2<<endl;
-    //cout << p1I1<<","<<p1I2<<","<<p2I1<<","<<p2I2<<endl;
-    return abs(p1I1-p1I2) + abs(p2I1-p2I2);	
-}
-
-double computeWeight(int i1, int j1, int i2, int j2, int lambda, int max_lambda, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point& offset1, Point& offset2){
-    double c1 = computeBGRWeight(i1,j1,i2,j2,I1color,I2color,offset1,offset2);
-    double c2 = computeGradientWeight(i1,j1,i2,j2,G1,G2,offset1,offset2);
-    if(c1>INF || c1<0) c1=INF;
-    if(c2>INF || c2<0) c2=INF;
-    //cout << "c1="<<c1<<",c2="<<c2<<endl;
-    if(max_lambda==0){
-        cout << "max_lambda was set to 0, but was supposed to be constant and greater than zero." << endl;
-        system("pause");
-        return 0;
-    }
-    double weight;
-    if(lambda==0) weight=c1;
-    else if(lambda==max_lambda) weight=c2;
-    else if(c1>=INF-1||c2>=INF-1)
-        weight=INF;
-    else{
-        weight=( (max_lambda-lambda)*c1 + lambda*c2 )/max_lambda;
-        if(weight>=INF-1)
-            weight=INF;
-    }
-    return weight;
-}
-
-Graph<double,double,double>createGraphFromRectangle(const Rectangle& rec, const Rectangle& overlap, bool right_order1, bool right_order2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point offset1, Point offset2, int type, int delta, int lambda, int max_lambda){
-    Graph<double,double,double> G((rec.p2.x-rec.p1.x)*(rec.p2.y-rec.p1.y),2*(rec.p2.x-rec.p1.x)*(rec.p2.y-rec.p1.y));
-    G.add_node((rec.p2.x-rec.p1.x)*(rec.p2.y-rec.p1.y));
-    for(int i=rec.p1.x; i<rec.p2.x; i++){
-        for(int j=rec.p1.y; j<rec.p2.y; j++){
-            // if we are analyzing a point in the intersection region
-            if(i>=overlap.p1.x && i<overlap.p2.x && j>=overlap.p1.y && j<overlap.p2.y){
-                // we add edges between adjacent points
-                if(i<overlap.p2.x-1)
-                    G.add_edge((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), (i+1-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), computeWeight(i,j,i+1,j,lambda,max_lambda,I1color,I2color,G1,G2,offset1,offset2), computeWeight(i,j,i+1,j,lambda,max_lambda,I1color,I2color, G1, G2, offset1,offset2));
-                // we add edges between adjacent points
-                if(j<overlap.p2.y-1)
-                    G.add_edge((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), (i-rec.p1.x)+(j+1-rec.p1.y)*(rec.p2.x-rec.p1.x), computeWeight(i,j,i,j+1,lambda,max_lambda,I1color,I2color,G1,G2,offset1,offset2), computeWeight(i,j,i,j+1,lambda,max_lambda,I1color,I2color, G1, G2, offset1,offset2));
-                // we assign points close to the border to the image they are the closest
-                if(type==1 && i<overlap.p1.x+delta){
-                    if(right_order1)
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-                    else
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                }
-                if(type==1 && i>overlap.p2.x-delta){
-                    if(right_order1)
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                    else
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-                }
-                if(type==2 && j<overlap.p1.y+delta){
-                    if(right_order2)
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-                    else
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                }
-                if(type==2 && j>overlap.p2.y-delta){
-                    if(right_order2)
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                    else
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-                }
-            }
-
-            // here we assign points that belong to only one of the images to this image
-            else if(i<overlap.p1.x || j<overlap.p1.y){
-                if(type==1){
-                    if(right_order1)
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-                    else
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                }
-                else{
-                    if(right_order2)
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-                    else
-                        G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                }
-            }
-            // here we assign points that belong to only one of the images to this image
-            else if(i>=overlap.p2.x || j>=overlap.p2.y){
-                if((type==1 && right_order1) || type==2 && right_order2)
-                    G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), 0, INF);
-                else
-                    G.add_tweights((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x), INF, 0);
-            }
-            // by logics, we shouldn't enter this case
-            else
-                cout << "something went wrong" << endl;
-        }
-    }
-    return G;
-}
-
-void selectRectangles(const vector<Rectangle>&combined_coordinates, Rectangle& rec, Rectangle& overlap, int type){
-    if(type==1)
-        rec = combined_coordinates[0]; // coordinates of rectangle in the horizontal
-    else if(type==2)
-        rec =  combined_coordinates[1]; // coordinates of rectangle in the vertical
-    else{
-        cout << "wrong type given " << endl;
-        return;
-    }
-    overlap = combined_coordinates[2]; // overlapped rectangle
-}
-
-void generateImagesFromGraphAndRec(Image<Vec3b>&label, Image<float>&label2, const Graph<double,double,double>&G, const Rectangle& rec, const Rectangle& overlap, bool right_order1, bool right_order2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, int type, int delta, int lambda){
-    for (int i=rec.p1.x;i<rec.p2.x;i++)
-        for (int j=rec.p1.y;j<rec.p2.y;j++){
-            //cout << "i, j = " << i << " " <<  j << " first image dimensions : from " << rec.p1.x << ", " << rec.p1.y << " to " << rec.p2.x << ", " << rec.p2.y << endl;
-            label(i-rec.p1.x,j-rec.p1.y)= (G.what_segment((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x)) == Graph<double,double,double>::SOURCE) ? I1color(i-offset1.x,j-offset1.y) : I2color(i-offset2.x,j-offset2.y);
-            label2(i-rec.p1.x,j-rec.p1.y)= (G.what_segment((i-rec.p1.x)+(j-rec.p1.y)*(rec.p2.x-rec.p1.x)) == Graph<double,double,double>::SOURCE) ? 1 : 0;
-        }
-}
-
 Image<Vec3b> image_montage;
+Image<float> image_cut;
+// when set, do_photomontage only computes the result and never opens a window
+bool headless=false;
+// parameters that have no trackbar, set from the command line options
+MontageParams montage_options;
+// in batch mode, the offsets of the jobs are estimated from the images instead of read
+bool auto_offset=false;
+// lines of the strips and of their halo in tiled mode
+int tile_strip=1024, tile_halo=64;
+// candidates solved by maxflow in search mode
+int search_top=4;
+// label map and seam files written next to the cut of the batch jobs, see labelMap.h
+bool write_label_map=false;
+LabelMapWriter* job_label_map=NULL;
+// patches of the texture mode
+TextureParams texture_options;
+// gradients of the images, kept between trackbar events
+GradientCache gradient_cache;
+// graph of the interactive montage, updated in place when only lambda or delta change
+IncrementalMontage interactive_montage;
 
-void do_photomontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, int type=1, int delta=5, bool showCut=false, int lambda=0, int max_lambda=10, bool blur_image=true){
-    type++;
-    bool right_order1=true, right_order2=true;	
-    vector<Rectangle>combined_coordinates = rectangleOverlap(I1color, I2color, offset1, offset2, right_order1, right_order2);
-    Rectangle overlap, rec;
-    selectRectangles(combined_coordinates, rec, overlap, type);
-    Image<float>G1(I1color.width(), I1color.height(), CV_32F);
-    computeGradient(I1color, G1, blur_image);
-    cout << "computed first gradient" << endl;
-    Image<float>G2(I2color.width(), I2color.height(), CV_32F);
-    computeGradient(I2color, G2, blur_image);
-    cout << "computed second gradient" << endl;
-    Graph<double,double,double> G = createGraphFromRectangle(rec, overlap, right_order1, right_order2, I1color, I2color, G1, G2, offset1, offset2, type, delta, lambda, max_lambda);
-    cout << "computed graph" << endl;	
-    double flow=G.maxflow();
+bool do_photomontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, int type=1, int delta=5, bool showCut=false, int lambda=0, int max_lambda=10, bool blur_image=true){
+    MontageParams params = montage_options;
+    params.type = type+1;
+    params.delta = delta;
+    params.lambda = lambda;
+    params.max_lambda = max_lambda;
+    params.blur_image = blur_image;
+    Image<Vec3b> label;
+    Image<float> label2;
+    double flow;
+    if(headless)
+        flow = photomontage(I1color, I2color, offset1, offset2, label, label2, params, &gradient_cache, job_label_map);
+    else
+        flow = interactive_montage.update(I1color, I2color, offset1, offset2, label, label2, params, &gradient_cache);
+    if(flow<0)
+        return false;
     cout << "computed flow: " << flow << endl;
-
-    Image<Vec3b> label(rec.p2.x-rec.p1.x,rec.p2.y-rec.p1.y, DataType<Vec3b>::type);
-    Image<float> label2(rec.p2.x-rec.p1.x,rec.p2.y-rec.p1.y, DataType<float>::type);
-    generateImagesFromGraphAndRec(label, label2, G, rec, overlap, right_order1, right_order2, I1color, I2color, offset1, offset2, type, delta,lambda);
-    cout << "generated images" << endl;
-    image_montage = label.clone();
+    image_montage = label;
+    image_cut = label2;
+    if(headless)
+        return true;
     if(showCut){
         imshow("mywindow", label2);
         waitKey();
@@ -233,6 +78,7 @@ void do_photomontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Poi
         imshow("mywindow", label);
         waitKey();
     }
+    return true;
 }
 /*
    At first, we use some global variables
@@ -263,11 +109,479 @@ void do_pmtg_trackbar(int, void *){
     }
 }
 
+/*
+   Headless batch mode. A job is described by the fields
+   image1 image2 x_1 y_1 x_2 y_2 type delta lambda blur montage cut
+   where type and blur take the same values as the trackbars (0 or 1) and
+   montage/cut are the output files for the fused image and the cut mask.
+   */
+
+const int job_fields=12;
+
+bool run_job(const vector<string>& job){
+    double t0 = (double)getTickCount();
+    Image<Vec3b> J1 = imread(job[0]);
+    Image<Vec3b> J2 = imread(job[1]);
+    if(J1.empty() || J2.empty()){
+        cout << "could not read " << (J1.empty() ? job[0] : job[1]) << endl;
+        return false;
+    }
+    Point offset1(atoi(job[2].c_str()), atoi(job[3].c_str()));
+    Point offset2(atoi(job[4].c_str()), atoi(job[5].c_str()));
+    int type = atoi(job[6].c_str()), delta = atoi(job[7].c_str()), lambda = atoi(job[8].c_str());
+    bool blur_image = atoi(job[9].c_str())!=0;
+    if(type<0 || type>1 || lambda<0 || lambda>max_lambda){
+        cout << "wrong parameters for job " << job[0] << " " << job[1] << endl;
+        return false;
+    }
+    if(auto_offset){
+        if(!estimateOffsets(J1, J2, offset1, offset2))
+            return false;
+        cout << "job " << job[10] << ": offsets " << offset1.x << " " << offset1.y << " " << offset2.x << " " << offset2.y << endl;
+    }
+    double t1 = (double)getTickCount();
+    LabelMapWriter label_map(job[11]+".rle", job[11]+".seam");
+    job_label_map = write_label_map ? &label_map : NULL;
+    bool done = do_photomontage(J1, J2, offset1, offset2, type, delta, false, lambda, max_lambda, blur_image);
+    job_label_map = NULL;
+    // the images of the next job are read again, their gradients cannot be reused
+    gradient_cache.clear();
+    if(!done)
+        return false;
+    double t2 = (double)getTickCount();
+
+    Mat cut;
+    image_cut.convertTo(cut, CV_8U, 255);
+    if(!imwrite(job[10], image_montage) || !imwrite(job[11], cut)){
+        cout << "could not write " << job[10] << " or " << job[11] << endl;
+        return false;
+    }
+    double t3 = (double)getTickCount();
+    cout << "job " << job[10] << ": read " << (t1-t0)*1000./getTickFrequency() << " ms, montage "
+         << (t2-t1)*1000./getTickFrequency() << " ms, write " << (t3-t2)*1000./getTickFrequency() << " ms" << endl;
+    return true;
+}
+
+// reads one job per line, empty lines and lines starting with '#' are skipped
+int run_job_file(const char* filename){
+    ifstream in(filename);
+    if(!in){
+        cout << "could not open job file " << filename << endl;
+        return -1;
+    }
+    double t0 = (double)getTickCount();
+    int done=0, failed=0;
+    string line;
+    while(getline(in, line)){
+        istringstream fields(line);
+        vector<string> job;
+        string f;
+        while(fields >> f)
+            job.push_back(f);
+        if(job.empty() || job[0][0]=='#')
+            continue;
+        if((int)job.size()!=job_fields){
+            cout << "skipping malformed job: " << line << endl;
+            failed++;
+            continue;
+        }
+        if(run_job(job)) done++;
+        else failed++;
+    }
+    cout << done << " jobs done, " << failed << " failed in " << ((double)getTickCount()-t0)/getTickFrequency() << " s" << endl;
+    return failed==0 ? 0 : -1;
+}
+
+// same job as run_job, for binary PPM images solved strip by strip without loading them (the cut is written as PGM)
+bool run_tiled_job(const vector<string>& job){
+    Point offset1(atoi(job[2].c_str()), atoi(job[3].c_str()));
+    Point offset2(atoi(job[4].c_str()), atoi(job[5].c_str()));
+    int type = atoi(job[6].c_str()), lambda = atoi(job[8].c_str());
+    if(type<0 || type>1 || lambda<0 || lambda>max_lambda){
+        cout << "wrong parameters for job " << job[0] << " " << job[1] << endl;
+        return false;
+    }
+    MontageParams params = montage_options;
+    params.type = type+1;
+    params.delta = atoi(job[7].c_str());
+    params.lambda = lambda;
+    params.max_lambda = max_lambda;
+    params.blur_image = atoi(job[9].c_str())!=0;
+    double t0 = (double)getTickCount();
+    LabelMapWriter label_map(job[11]+".rle", job[11]+".seam");
+    double flow = tiledPhotomontage(job[0], job[1], offset1, offset2, job[10], job[11], params, tile_strip, tile_halo, write_label_map ? &label_map : NULL);
+    if(flow<0)
+        return false;
+    cout << "computed flow: " << flow << endl;
+    cout << "job " << job[10] << ": " << ((double)getTickCount()-t0)*1000./getTickFrequency() << " ms" << endl;
+    return true;
+}
+
+/*
+   Headless montage of any number of images, described by the fields
+   lambda blur montage labels image1 x1 y1 image2 x2 y2 ...
+   labels is the output file for the index of the image of each point (255 where there is none). With more than 255
+   images, labels is written with 16 bits (65535 where there is none), which needs a PNG or TIFF file.
+   */
+
+const int multi_fields=4;
+
+bool run_multi(const vector<string>& job){
+    int lambda = atoi(job[0].c_str());
+    if(lambda<0 || lambda>max_lambda){
+        cout << "wrong lambda " << job[0] << endl;
+        return false;
+    }
+    MontageParams params = montage_options;
+    params.lambda = lambda;
+    params.max_lambda = max_lambda;
+    params.blur_image = atoi(job[1].c_str())!=0;
+    vector<MontageSource> sources;
+    for(size_t k=multi_fields; k+2<job.size(); k+=3){
+        Image<Vec3b> J = imread(job[k]);
+        if(J.empty()){
+            cout << "could not read " << job[k] << endl;
+            return false;
+        }
+        sources.push_back(MontageSource(J, Point(atoi(job[k+1].c_str()), atoi(job[k+2].c_str()))));
+    }
+    // the largest value of the label map marks the points without any image
+    if(sources.size()>65535){
+        cout << "at most 65535 images can be combined, not " << sources.size() << endl;
+        return false;
+    }
+    bool labels16 = sources.size()>255;
+    double t0 = (double)getTickCount();
+    Image<Vec3b> montage;
+    Image<int> labels;
+    double cost = multiPhotomontage(sources, montage, labels, params);
+    if(cost<0)
+        return false;
+    cout << "seam cost: " << cost << " in " << ((double)getTickCount()-t0)*1000./getTickFrequency() << " ms" << endl;
+    Mat label_map;
+    labels.convertTo(label_map, labels16 ? CV_16U : CV_8U);
+    label_map.setTo(labels16 ? 65535 : 255, labels<0);
+    if(!imwrite(job[2], montage) || !imwrite(job[3], label_map)){
+        cout << "could not write " << job[2] << " or " << job[3] << endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+   Search mode: the fields are the ones of a batch job, with the range of the translation
+   offset2-offset1 and the step of its grid instead of the offsets:
+   image1 image2 dx_min dy_min dx_max dy_max step type delta lambda blur montage cut
+   */
+
+const int search_fields=13;
+
+bool run_search(const vector<string>& job){
+    Image<Vec3b> J1 = imread(job[0]);
+    Image<Vec3b> J2 = imread(job[1]);
+    if(J1.empty() || J2.empty()){
+        cout << "could not read " << (J1.empty() ? job[0] : job[1]) << endl;
+        return false;
+    }
+    Point d_min(atoi(job[2].c_str()), atoi(job[3].c_str()));
+    Point d_max(atoi(job[4].c_str()), atoi(job[5].c_str()));
+    int step = atoi(job[6].c_str()), type = atoi(job[7].c_str()), lambda = atoi(job[9].c_str());
+    if(type<0 || type>1 || lambda<0 || lambda>max_lambda || step<1){
+        cout << "wrong parameters for the search " << job[0] << " " << job[1] << endl;
+        return false;
+    }
+    MontageParams params = montage_options;
+    params.type = type+1;
+    params.delta = atoi(job[8].c_str());
+    params.lambda = lambda;
+    params.max_lambda = max_lambda;
+    params.blur_image = atoi(job[10].c_str())!=0;
+    double t0 = (double)getTickCount();
+    Image<Vec3b> montage;
+    Image<float> cut;
+    vector<OffsetCandidate> candidates = searchOffsets(J1, J2, d_min, d_max, step, montage, cut, params, search_top);
+    if(candidates.empty() || candidates[0].cost<0){
+        cout << "no candidate offset could be solved" << endl;
+        return false;
+    }
+    for(size_t k=0; k<candidates.size(); k++)
+        cout << "offsets " << candidates[k].offset1.x << " " << candidates[k].offset1.y << " " << candidates[k].offset2.x << " " << candidates[k].offset2.y
+             << ": bounds " << candidates[k].lower_bound << " " << candidates[k].upper_bound << ", cost " << candidates[k].cost << endl;
+    cout << "search: " << ((double)getTickCount()-t0)*1000./getTickFrequency() << " ms" << endl;
+    Mat cut8;
+    cut.convertTo(cut8, CV_8U, 255);
+    if(!imwrite(job[11], montage) || !imwrite(job[12], cut8)){
+        cout << "could not write " << job[11] << " or " << job[12] << endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+   Warp mode: image2 is mapped onto image1 by the homography h11..h33 (row by row, from the points of image2 to the
+   points of image1), the seam is cut over the intersection of their masks:
+   image1 image2 h11 h12 h13 h21 h22 h23 h31 h32 h33 delta lambda blur montage cut
+   */
+
+const int warp_fields=16;
+// largest canvas of a warp, in points per point of the two images
+const double max_warp_canvas=16;
+
+bool run_warp(const vector<string>& job){
+    Image<Vec3b> J1 = imread(job[0]);
+    Image<Vec3b> J2 = imread(job[1]);
+    if(J1.empty() || J2.empty()){
+        cout << "could not read " << (J1.empty() ? job[0] : job[1]) << endl;
+        return false;
+    }
+    Matx33d H;
+    for(int k=0; k<9; k++)
+        H.val[k] = atof(job[2+k].c_str());
+    int lambda = atoi(job[12].c_str());
+    if(lambda<0 || lambda>max_lambda){
+        cout << "wrong parameters for the warp " << job[0] << " " << job[1] << endl;
+        return false;
+    }
+    MontageParams params = montage_options;
+    params.delta = atoi(job[11].c_str());
+    params.lambda = lambda;
+    params.max_lambda = max_lambda;
+    params.blur_image = atoi(job[13].c_str())!=0;
+
+    // H is known up to a factor, the determinant is compared to the one of its norm
+    double n = norm(H);
+    if(!(fabs(determinant(H))>1e-12*n*n*n)){
+        cout << "the homography of " << job[1] << " is singular" << endl;
+        return false;
+    }
+    // the whole image2 must lie in front of the horizon: the same sign of w at its corners, made positive
+    double w2 = J2.width()-1, h2 = J2.height()-1;
+    const Vec3d homogeneous[4] = {H*Vec3d(0, 0, 1), H*Vec3d(w2, 0, 1), H*Vec3d(w2, h2, 1), H*Vec3d(0, h2, 1)};
+    if(homogeneous[0][2]<0)
+        for(int k=0; k<9; k++)
+            H.val[k] = -H.val[k];
+    for(int k=0; k<4; k++)
+        if(!(fabs(homogeneous[k][2])>1e-12*n) || (homogeneous[k][2]>0)!=(homogeneous[0][2]>0)){
+            cout << "the homography sends a corner of " << job[1] << " to infinity or behind the camera" << endl;
+            return false;
+        }
+
+    // canvas: bounding box of image1 and of the projection of image2
+    double x0 = 0, y0 = 0, x1 = J1.width(), y1 = J1.height();
+    const Point2d corners[4] = {HomographySource::project(H, 0, 0), HomographySource::project(H, w2, 0), HomographySource::project(H, w2, h2), HomographySource::project(H, 0, h2)};
+    for(int k=0; k<4; k++){
+        x0 = min(x0, corners[k].x);
+        y0 = min(y0, corners[k].y);
+        x1 = max(x1, corners[k].x+1);
+        y1 = max(y1, corners[k].y+1);
+    }
+    if((x1-x0)*(y1-y0)>max_warp_canvas*((double)J1.width()*J1.height()+(double)J2.width()*J2.height())){
+        cout << "the projection of " << job[1] << " is too large: " << x1-x0 << "x" << y1-y0 << " canvas" << endl;
+        return false;
+    }
+    Point corner((int)floor(x0), (int)floor(y0));
+    Size canvas((int)ceil(x1)-corner.x, (int)ceil(y1)-corner.y);
+    Matx33d T(1, 0, -corner.x, 0, 1, -corner.y, 0, 0, 1);
+
+    double t0 = (double)getTickCount();
+    TranslatedSource S1(J1, -corner, canvas, params.blur_image);
+    HomographySource S2(J2, T*H, canvas, params.blur_image);
+    Image<Vec3b> montage;
+    Image<float> cut;
+    Point origin;
+    double flow = maskPhotomontage(S1, S2, montage, cut, origin, params);
+    if(flow<0)
+        return false;
+    cout << "computed flow: " << flow << endl;
+    cout << "warp " << job[14] << ": " << ((double)getTickCount()-t0)*1000./getTickFrequency() << " ms" << endl;
+    Mat cut8;
+    cut.convertTo(cut8, CV_8U, 255);
+    if(!imwrite(job[14], montage) || !imwrite(job[15], cut8)){
+        cout << "could not write " << job[14] << " or " << job[15] << endl;
+        return false;
+    }
+    return true;
+}
+
+// texture mode: sample width height output
+bool run_texture(const vector<string>& job){
+    Image<Vec3b> sample = imread(job[0]);
+    if(sample.empty()){
+        cout << "could not read " << job[0] << endl;
+        return false;
+    }
+    Size size(atoi(job[1].c_str()), atoi(job[2].c_str()));
+    if(size.width<=0 || size.height<=0){
+        cout << "wrong size " << job[1] << " " << job[2] << endl;
+        return false;
+    }
+    double t0 = (double)getTickCount();
+    Image<Vec3b> output;
+    if(!synthesizeTexture(sample, size, output, texture_options))
+        return false;
+    cout << "texture " << job[3] << ": " << ((double)getTickCount()-t0)*1000./getTickFrequency() << " ms" << endl;
+    if(!imwrite(job[3], output)){
+        cout << "could not write " << job[3] << endl;
+        return false;
+    }
+    return true;
+}
+
+void usage(){
+    cout << " Usage: ./Fusion image1 image2 or ./Fusion image1" << endl;
+    cout << "        ./Fusion --batch [options] image1 image2 x_1 y_1 x_2 y_2 type delta lambda blur montage cut" << endl;
+    cout << "        ./Fusion --jobs [options] jobfile" << endl;
+    cout << "        ./Fusion --tiled [options] image1.ppm image2.ppm x_1 y_1 x_2 y_2 type delta lambda blur montage.ppm cut.pgm" << endl;
+    cout << "        ./Fusion --search [options] image1 image2 dx_min dy_min dx_max dy_max step type delta lambda blur montage cut" << endl;
+    cout << "        ./Fusion --warp [options] image1 image2 h11 h12 h13 h21 h22 h23 h31 h32 h33 delta lambda blur montage cut" << endl;
+    cout << "        ./Fusion --texture [options] sample width height output" << endl;
+    cout << "        ./Fusion --multi [options] lambda blur montage labels image1 x_1 y_1 image2 x_2 y_2 ..." << endl;
+    cout << " Options: --capacity double|float|int|short   type of the capacities of the graph" << endl;
+    cout << "          --scale s                           fixed-point scale of integer capacities (at most 9 for short)" << endl;
+    cout << "          --pyramid levels                    find the seam at lower resolutions first" << endl;
+    cout << "          --band b                            width kept free around the coarse seam" << endl;
+    cout << "          --solver bk|parallel|grid           maxflow on one thread, on bands of rows in parallel, or on a grid graph" << endl;
+    cout << "          --threads n                         threads building and solving the graph (all the cores by default)" << endl;
+    cout << "          --blend none|poisson|multiband      blend the montage after the cut" << endl;
+    cout << "          --blend-band b                      distance to the seam of the points blended in multiband mode" << endl;
+    cout << "          --overlap rectangle|mask            cut the overlap rectangle across type, or the intersection of the image masks" << endl;
+    cout << "          --auto-offset on|off                estimate the offsets of the batch jobs from the images" << endl;
+    cout << "          --label-map on|off                  also write the cut of batch jobs as cut.rle and its seam as cut.seam" << endl;
+    cout << "          --huge-pages on|off                 huge pages for the memory of large graphs" << endl;
+    cout << "          --strip n                           lines of the strips in tiled mode" << endl;
+    cout << "          --top k                             candidates solved by maxflow in search mode" << endl;
+    cout << "          --patch n                           size of the patches in texture mode" << endl;
+    cout << "          --patch-overlap n                   points shared by neighbouring patches in texture mode" << endl;
+    cout << "          --seed n                            seed of the random choices of the texture mode" << endl;
+    cout << "          --halo n                            lines read around each strip in tiled mode" << endl;
+}
+
+// reads the options starting at argv[i] into montage_options, returns the index of the first argument that is not an option or -1 on error
+int parse_options(int argc, char** argv, int i){
+    for(; i<argc && string(argv[i]).compare(0,2,"--")==0; i+=2){
+        string option(argv[i]);
+        if(i+1>=argc){
+            cout << "missing value for " << option << endl;
+            return -1;
+        }
+        string value(argv[i+1]);
+        if(option=="--capacity"){
+            if(value=="double") montage_options.capacity = CAPACITY_DOUBLE;
+            else if(value=="float") montage_options.capacity = CAPACITY_FLOAT;
+            else if(value=="int") montage_options.capacity = CAPACITY_INT;
+            else if(value=="short") montage_options.capacity = CAPACITY_SHORT;
+            else{
+                cout << "unknown capacity type " << value << endl;
+                return -1;
+            }
+        }
+        else if(option=="--scale")
+            montage_options.capacity_scale = atof(value.c_str());
+        else if(option=="--pyramid")
+            montage_options.pyramid_levels = atoi(value.c_str());
+        else if(option=="--band")
+            montage_options.band = atoi(value.c_str());
+        else if(option=="--solver"){
+            if(value=="bk") montage_options.solver = SOLVER_BK;
+            else if(value=="parallel") montage_options.solver = SOLVER_PARALLEL;
+            else if(value=="grid") montage_options.solver = SOLVER_GRID;
+            else{
+                cout << "unknown solver " << value << endl;
+                return -1;
+            }
+        }
+        else if(option=="--threads")
+            setParallelThreads(atoi(value.c_str()));
+        else if(option=="--blend"){
+            if(value=="none") montage_options.blend = BLEND_NONE;
+            else if(value=="poisson") montage_options.blend = BLEND_POISSON;
+            else if(value=="multiband") montage_options.blend = BLEND_MULTIBAND;
+            else{
+                cout << "unknown blending " << value << endl;
+                return -1;
+            }
+        }
+        else if(option=="--blend-band")
+            montage_options.blend_band = atoi(value.c_str());
+        else if(option=="--overlap"){
+            if(value=="rectangle") montage_options.overlap = OVERLAP_RECTANGLE;
+            else if(value=="mask") montage_options.overlap = OVERLAP_MASK;
+            else{
+                cout << "unknown overlap " << value << endl;
+                return -1;
+            }
+        }
+        else if(option=="--auto-offset"){
+            if(value!="on" && value!="off"){
+                cout << "--auto-offset takes on or off" << endl;
+                return -1;
+            }
+            auto_offset = value=="on";
+        }
+        else if(option=="--label-map"){
+            if(value!="on" && value!="off"){
+                cout << "--label-map takes on or off" << endl;
+                return -1;
+            }
+            write_label_map = value=="on";
+        }
+        else if(option=="--huge-pages"){
+            if(value!="on" && value!="off"){
+                cout << "--huge-pages takes on or off" << endl;
+                return -1;
+            }
+            graphArena().set_huge_pages(value=="on");
+        }
+        else if(option=="--strip")
+            tile_strip = atoi(value.c_str());
+        else if(option=="--top")
+            search_top = atoi(value.c_str());
+        else if(option=="--patch")
+            texture_options.patch = atoi(value.c_str());
+        else if(option=="--patch-overlap")
+            texture_options.overlap = atoi(value.c_str());
+        else if(option=="--seed")
+            texture_options.seed = atoi(value.c_str());
+        else if(option=="--halo")
+            tile_halo = atoi(value.c_str());
+        else{
+            cout << "unknown option " << option << endl;
+            return -1;
+        }
+    }
+    if(montage_options.capacity==CAPACITY_SHORT && montage_options.capacity_scale>capacityScale<short>(montage_options.capacity_scale))
+        cout << "--scale " << montage_options.capacity_scale << " would saturate short capacities, using " << capacityScale<short>(montage_options.capacity_scale) << endl;
+    return i;
+}
+
 int main (int argc, char** argv) {
 
     if( argc < 2)
     {
-        cout <<" Usage: ./Fusion image1 image2 or ./Fusion image1" << endl;
+        usage();
+        return -1;
+    }
+
+    if(string(argv[1])=="--batch" || string(argv[1])=="--jobs" || string(argv[1])=="--multi" || string(argv[1])=="--tiled" || string(argv[1])=="--search" || string(argv[1])=="--texture" || string(argv[1])=="--warp"){
+        headless = true;
+        int first = parse_options(argc, argv, 2);
+        if(first<0)
+            return -1;
+        if(string(argv[1])=="--jobs" && argc==first+1)
+            return run_job_file(argv[first]);
+        if(string(argv[1])=="--batch" && argc==first+job_fields)
+            return run_job(vector<string>(argv+first, argv+argc)) ? 0 : -1;
+        if(string(argv[1])=="--tiled" && argc==first+job_fields)
+            return run_tiled_job(vector<string>(argv+first, argv+argc)) ? 0 : -1;
+        if(string(argv[1])=="--warp" && argc==first+warp_fields)
+            return run_warp(vector<string>(argv+first, argv+argc)) ? 0 : -1;
+        if(string(argv[1])=="--texture" && argc==first+4)
+            return run_texture(vector<string>(argv+first, argv+argc)) ? 0 : -1;
+        if(string(argv[1])=="--search" && argc==first+search_fields)
+            return run_search(vector<string>(argv+first, argv+argc)) ? 0 : -1;
+        if(string(argv[1])=="--multi" && argc>first+multi_fields && (argc-first-multi_fields)%3==0)
+            return run_multi(vector<string>(argv+first, argv+argc)) ? 0 : -1;
+        usage();
         return -1;
     }
 
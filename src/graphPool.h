@@ -0,0 +1,80 @@
+#pragma once
+
+#include "maxflow/graph.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Graphs kept from one solve to the next: acquire() hands out a graph that was released before, reset and with room
+// for the requested size, so that montages of similar sizes reuse the memory of the previous ones instead of
+// allocating their nodes and arcs again. The graph goes back to the pool when its handle is destroyed.
+// A pool can be used from several threads; it keeps as many graphs as were used at the same time. Its graphs allocate
+// from arena when it is not NULL, so that the orphan blocks of maxflow() and the graphs growing to a larger size reuse
+// memory too.
+template <typename captype, typename tcaptype, typename flowtype>
+class GraphPool {
+public:
+    typedef Graph<captype,tcaptype,flowtype> GraphType;
+    struct Release {
+        GraphPool* pool;
+        void operator()(GraphType* G) const { pool->release(G); }
+    };
+    typedef std::unique_ptr<GraphType,Release> GraphPtr;
+
+    GraphPool(GraphArena* arena = NULL) : arena(arena) {}
+    GraphPool(const GraphPool&) = delete;
+    GraphPool& operator=(const GraphPool&) = delete;
+    ~GraphPool() { clear(); }
+
+    // empty graph with room for node_num nodes and edge_num edges
+    GraphPtr acquire(int node_num, int edge_num){
+        GraphType* G = NULL;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!graphs.empty()){
+                G = graphs.back();
+                graphs.pop_back();
+            }
+        }
+        if(G){
+            G->reset();
+            G->reserve(node_num, edge_num);
+        }
+        else
+            G = new GraphType(node_num, edge_num, NULL, arena);
+        Release r = {this};
+        return GraphPtr(G, r);
+    }
+
+    // frees the graphs that are not in use
+    void clear(){
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t k=0; k<graphs.size(); k++)
+            delete graphs[k];
+        graphs.clear();
+    }
+
+private:
+    GraphArena* arena;
+    std::mutex mutex;
+    std::vector<GraphType*> graphs;
+
+    void release(GraphType* G){
+        std::lock_guard<std::mutex> lock(mutex);
+        graphs.push_back(G);
+    }
+};
+
+// arena of the graphs of graphPool()
+inline GraphArena& graphArena(){
+    static GraphArena arena;
+    return arena;
+}
+
+// pool shared by all the solves with these capacity types
+template <typename captype, typename tcaptype, typename flowtype>
+GraphPool<captype,tcaptype,flowtype>& graphPool(){
+    static GraphPool<captype,tcaptype,flowtype> pool(&graphArena());
+    return pool;
+}
@@ -0,0 +1,424 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <limits>
+#include <assert.h>
+
+// Graph of a 4-connected grid of width x height points, solved with the same Boykov-Kolmogorov algorithm as Graph
+// (maxflow/maxflow.inc), with the same add_tweights/add_edge/maxflow/what_segment functions.
+//
+// Graph stores for each arc its head, next and sister pointers besides its capacity, and links the arcs of a node
+// through node::first. Here the neighbours of a point are given by its index: the only arc data are the residual
+// capacities, in one dense plane per direction, and a node stores the direction of its parent instead of a pointer.
+// For double capacities a point takes about 56 bytes instead of about 176 with Graph, and the arcs of neighbouring
+// points are next to each other in memory.
+//
+// The grid has a border of one point on each side that has no capacity, so that the neighbours of any point can be
+// read without testing the border. Every point of the grid is a node, those without any edge or t-link stay isolated.
+// The search trees are not reused between calls to maxflow().
+template <typename captype, typename tcaptype, typename flowtype>
+class GridGraph {
+public:
+    typedef enum { SOURCE=0, SINK=1 } termtype;
+    typedef int node_id;
+
+    GridGraph(int width, int height);
+
+    // node of the point (x,y) of the grid
+    node_id node(int x, int y) const { return (x+1)+(y+1)*W; }
+
+    // same as Graph::add_tweights
+    void add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink);
+    // same as Graph::set_tweights, for building the graph on several threads: add_tweights for a node without t-links
+    // yet, which only writes that node and returns min(cap_source,cap_sink) instead of adding it to the flow. The sum
+    // of the returned values must then be passed to add_flow() by a single thread.
+    tcaptype set_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink);
+    void add_flow(flowtype f) { flow += f; }
+    // adds the capacities cap (i->j) and rev_cap (j->i) to the edge between i and j, which must be neighbours
+    void add_edge(node_id i, node_id j, captype cap, captype rev_cap);
+
+    flowtype maxflow();
+    termtype what_segment(node_id i, termtype default_segm = SOURCE) const;
+
+    // bytes used by the nodes and the capacities
+    size_t memory() const { return nodes.size()*(sizeof(Node)+4*sizeof(captype)); }
+
+private:
+    // parent of a node: none, the neighbour in direction parent-1, a terminal, or none yet because it is an orphan
+    enum { NO_PARENT=0, TERMINAL=5, ORPHAN=6 };
+    struct Node {
+        tcaptype tr_cap; // residual capacity of SOURCE->node if positive, minus the one of node->SINK if negative
+        int next;        // next active node, the node itself if it is the last one, -1 if it is not active
+        int TS;          // timestamp showing when DIST was computed
+        int DIST;        // distance to the terminal
+        unsigned char parent;
+        unsigned char is_sink;
+    };
+
+    int W, H;          // size with the border
+    int offset[4];     // index of the neighbour in each direction: right, down, left, up; the reverse of d is d^2
+    std::vector<Node> nodes;
+    std::vector<captype> rcap[4]; // rcap[d][i]: residual capacity of the arc from i to its neighbour in direction d
+    flowtype flow;
+
+    int queue_first[2], queue_last[2];
+    std::vector<int> orphans_front; // orphans found by augment, the last one first
+    std::deque<int> orphans_rear;
+    int TIME;
+
+    void set_active(int i);
+    int next_active();
+    void set_orphan_front(int i) { nodes[i].parent = ORPHAN; orphans_front.push_back(i); }
+    void set_orphan_rear(int i) { nodes[i].parent = ORPHAN; orphans_rear.push_back(i); }
+    void augment(int i, int d);
+    void process_source_orphan(int i);
+    void process_sink_orphan(int i);
+    // parent of a node in a tree
+    int parent_of(int i) const { return i+offset[nodes[i].parent-1]; }
+};
+
+template <typename captype, typename tcaptype, typename flowtype>
+GridGraph<captype,tcaptype,flowtype>::GridGraph(int width, int height) : W(width+2), H(height+2), flow(0), TIME(0){
+    offset[0] = 1;
+    offset[1] = W;
+    offset[2] = -1;
+    offset[3] = -W;
+    Node n = {0, -1, 0, 0, NO_PARENT, 0};
+    nodes.assign(W*H, n);
+    for(int d=0; d<4; d++)
+        rcap[d].assign(W*H, 0);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void GridGraph<captype,tcaptype,flowtype>::add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink){
+    tcaptype delta = nodes[i].tr_cap;
+    if(delta>0) cap_source += delta;
+    else cap_sink -= delta;
+    flow += (cap_source<cap_sink) ? cap_source : cap_sink;
+    nodes[i].tr_cap = cap_source-cap_sink;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline tcaptype GridGraph<captype,tcaptype,flowtype>::set_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink){
+    assert(nodes[i].tr_cap==0);
+    nodes[i].tr_cap = cap_source-cap_sink;
+    return (cap_source<cap_sink) ? cap_source : cap_sink;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void GridGraph<captype,tcaptype,flowtype>::add_edge(node_id i, node_id j, captype cap, captype rev_cap){
+    int d;
+    for(d=0; d<4 && i+offset[d]!=j; d++);
+    assert(d<4);
+    rcap[d][i] += cap;
+    rcap[d^2][j] += rev_cap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline typename GridGraph<captype,tcaptype,flowtype>::termtype GridGraph<captype,tcaptype,flowtype>::what_segment(node_id i, termtype default_segm) const{
+    if(nodes[i].parent)
+        return nodes[i].is_sink ? SINK : SOURCE;
+    return default_segm;
+}
+
+// Active nodes: same two queues as Graph
+template <typename captype, typename tcaptype, typename flowtype>
+inline void GridGraph<captype,tcaptype,flowtype>::set_active(int i){
+    if(nodes[i].next<0){
+        if(queue_last[1]>=0) nodes[queue_last[1]].next = i;
+        else queue_first[1] = i;
+        queue_last[1] = i;
+        nodes[i].next = i;
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline int GridGraph<captype,tcaptype,flowtype>::next_active(){
+    while(true){
+        int i = queue_first[0];
+        if(i<0){
+            queue_first[0] = i = queue_first[1];
+            queue_last[0] = queue_last[1];
+            queue_first[1] = queue_last[1] = -1;
+            if(i<0)
+                return -1;
+        }
+        if(nodes[i].next==i) queue_first[0] = queue_last[0] = -1;
+        else queue_first[0] = nodes[i].next;
+        nodes[i].next = -1;
+        // a node in the list is active iff it has a parent
+        if(nodes[i].parent)
+            return i;
+    }
+}
+
+// augments along the path through the arc from i (source tree) in direction d
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype,tcaptype,flowtype>::augment(int middle, int md){
+    int i;
+    tcaptype bottleneck = rcap[md][middle];
+    // finding the bottleneck capacity: the source tree, then the sink tree
+    for(i=middle; nodes[i].parent!=TERMINAL; i=parent_of(i)){
+        int d = nodes[i].parent-1;
+        if(bottleneck>rcap[d^2][i+offset[d]]) bottleneck = rcap[d^2][i+offset[d]];
+    }
+    if(bottleneck>nodes[i].tr_cap) bottleneck = nodes[i].tr_cap;
+    for(i=middle+offset[md]; nodes[i].parent!=TERMINAL; i=parent_of(i)){
+        int d = nodes[i].parent-1;
+        if(bottleneck>rcap[d][i]) bottleneck = rcap[d][i];
+    }
+    if(bottleneck>-nodes[i].tr_cap) bottleneck = -nodes[i].tr_cap;
+
+    // augmenting
+    rcap[md^2][middle+offset[md]] += bottleneck;
+    rcap[md][middle] -= bottleneck;
+    for(i=middle; nodes[i].parent!=TERMINAL; ){
+        int d = nodes[i].parent-1, j = i+offset[d];
+        rcap[d][i] += bottleneck;
+        rcap[d^2][j] -= bottleneck;
+        if(!rcap[d^2][j])
+            set_orphan_front(i);
+        i = j;
+    }
+    nodes[i].tr_cap -= bottleneck;
+    if(!nodes[i].tr_cap)
+        set_orphan_front(i);
+    for(i=middle+offset[md]; nodes[i].parent!=TERMINAL; ){
+        int d = nodes[i].parent-1, j = i+offset[d];
+        rcap[d^2][j] += bottleneck;
+        rcap[d][i] -= bottleneck;
+        if(!rcap[d][i])
+            set_orphan_front(i);
+        i = j;
+    }
+    nodes[i].tr_cap += bottleneck;
+    if(!nodes[i].tr_cap)
+        set_orphan_front(i);
+    flow += bottleneck;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype,tcaptype,flowtype>::process_source_orphan(int i){
+    const int INFINITE_D = std::numeric_limits<int>::max();
+    int d_min = INFINITE_D, a0_min = -1;
+    // trying to find a new parent
+    for(int a0=0; a0<4; a0++){
+        int j = i+offset[a0];
+        if(!rcap[a0^2][j] || nodes[j].is_sink || !nodes[j].parent)
+            continue;
+        // checking the origin of j
+        int d = 0, k = j;
+        while(true){
+            if(nodes[k].TS==TIME){
+                d += nodes[k].DIST;
+                break;
+            }
+            d++;
+            if(nodes[k].parent==TERMINAL){
+                nodes[k].TS = TIME;
+                nodes[k].DIST = 1;
+                break;
+            }
+            if(nodes[k].parent==ORPHAN){
+                d = INFINITE_D;
+                break;
+            }
+            k = parent_of(k);
+        }
+        if(d<INFINITE_D){ // j originates from the source
+            if(d<d_min){
+                a0_min = a0;
+                d_min = d;
+            }
+            // set marks along the path
+            for(k=j; nodes[k].TS!=TIME; k=parent_of(k)){
+                nodes[k].TS = TIME;
+                nodes[k].DIST = d--;
+            }
+        }
+    }
+    if(a0_min>=0){
+        nodes[i].parent = a0_min+1;
+        nodes[i].TS = TIME;
+        nodes[i].DIST = d_min+1;
+        return;
+    }
+    // no parent is found, process the neighbours
+    nodes[i].parent = NO_PARENT;
+    for(int a0=0; a0<4; a0++){
+        int j = i+offset[a0];
+        if(nodes[j].is_sink || !nodes[j].parent)
+            continue;
+        if(rcap[a0^2][j])
+            set_active(j);
+        int p = nodes[j].parent;
+        if(p!=TERMINAL && p!=ORPHAN && parent_of(j)==i)
+            set_orphan_rear(j);
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype,tcaptype,flowtype>::process_sink_orphan(int i){
+    const int INFINITE_D = std::numeric_limits<int>::max();
+    int d_min = INFINITE_D, a0_min = -1;
+    for(int a0=0; a0<4; a0++){
+        int j = i+offset[a0];
+        if(!rcap[a0][i] || !nodes[j].is_sink || !nodes[j].parent)
+            continue;
+        int d = 0, k = j;
+        while(true){
+            if(nodes[k].TS==TIME){
+                d += nodes[k].DIST;
+                break;
+            }
+            d++;
+            if(nodes[k].parent==TERMINAL){
+                nodes[k].TS = TIME;
+                nodes[k].DIST = 1;
+                break;
+            }
+            if(nodes[k].parent==ORPHAN){
+                d = INFINITE_D;
+                break;
+            }
+            k = parent_of(k);
+        }
+        if(d<INFINITE_D){ // j originates from the sink
+            if(d<d_min){
+                a0_min = a0;
+                d_min = d;
+            }
+            for(k=j; nodes[k].TS!=TIME; k=parent_of(k)){
+                nodes[k].TS = TIME;
+                nodes[k].DIST = d--;
+            }
+        }
+    }
+    if(a0_min>=0){
+        nodes[i].parent = a0_min+1;
+        nodes[i].TS = TIME;
+        nodes[i].DIST = d_min+1;
+        return;
+    }
+    nodes[i].parent = NO_PARENT;
+    for(int a0=0; a0<4; a0++){
+        int j = i+offset[a0];
+        if(!nodes[j].is_sink || !nodes[j].parent)
+            continue;
+        if(rcap[a0][i])
+            set_active(j);
+        int p = nodes[j].parent;
+        if(p!=TERMINAL && p!=ORPHAN && parent_of(j)==i)
+            set_orphan_rear(j);
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+flowtype GridGraph<captype,tcaptype,flowtype>::maxflow(){
+    queue_first[0] = queue_last[0] = -1;
+    queue_first[1] = queue_last[1] = -1;
+    orphans_front.clear();
+    orphans_rear.clear();
+    TIME = 0;
+    for(int i=0; i<(int)nodes.size(); i++){
+        Node& n = nodes[i];
+        n.next = -1;
+        n.TS = TIME;
+        if(n.tr_cap!=0){
+            // i is connected to the source or to the sink
+            n.is_sink = n.tr_cap<0;
+            n.parent = TERMINAL;
+            set_active(i);
+            n.DIST = 1;
+        }
+        else
+            n.parent = NO_PARENT;
+    }
+
+    int current = -1;
+    while(true){
+        int i = current;
+        if(i>=0){
+            nodes[i].next = -1; // remove active flag
+            if(!nodes[i].parent)
+                i = -1;
+        }
+        if(i<0 && (i=next_active())<0)
+            break;
+
+        // growth, until an arc from the source tree to the sink tree is found
+        int middle = -1, md = 0;
+        if(!nodes[i].is_sink){
+            for(int d=0; d<4; d++){
+                if(!rcap[d][i])
+                    continue;
+                int j = i+offset[d];
+                if(!nodes[j].parent){
+                    nodes[j].is_sink = 0;
+                    nodes[j].parent = (d^2)+1;
+                    nodes[j].TS = nodes[i].TS;
+                    nodes[j].DIST = nodes[i].DIST+1;
+                    set_active(j);
+                }
+                else if(nodes[j].is_sink){
+                    middle = i;
+                    md = d;
+                    break;
+                }
+                else if(nodes[j].TS<=nodes[i].TS && nodes[j].DIST>nodes[i].DIST){
+                    // heuristic - trying to make the distance from j to the source shorter
+                    nodes[j].parent = (d^2)+1;
+                    nodes[j].TS = nodes[i].TS;
+                    nodes[j].DIST = nodes[i].DIST+1;
+                }
+            }
+        }
+        else{
+            for(int d=0; d<4; d++){
+                int j = i+offset[d];
+                if(!rcap[d^2][j])
+                    continue;
+                if(!nodes[j].parent){
+                    nodes[j].is_sink = 1;
+                    nodes[j].parent = (d^2)+1;
+                    nodes[j].TS = nodes[i].TS;
+                    nodes[j].DIST = nodes[i].DIST+1;
+                    set_active(j);
+                }
+                else if(!nodes[j].is_sink){
+                    middle = j;
+                    md = d^2;
+                    break;
+                }
+                else if(nodes[j].TS<=nodes[i].TS && nodes[j].DIST>nodes[i].DIST){
+                    // heuristic - trying to make the distance from j to the sink shorter
+                    nodes[j].parent = (d^2)+1;
+                    nodes[j].TS = nodes[i].TS;
+                    nodes[j].DIST = nodes[i].DIST+1;
+                }
+            }
+        }
+
+        TIME++;
+        if(middle>=0){
+            nodes[i].next = i; // set active flag
+            current = i;
+            augment(middle, md);
+            // adoption: each orphan found by augment, then the orphans found while processing it
+            for(int k=(int)orphans_front.size()-1; k>=0; k--){
+                orphans_rear.push_back(orphans_front[k]);
+                while(!orphans_rear.empty()){
+                    int o = orphans_rear.front();
+                    orphans_rear.pop_front();
+                    if(nodes[o].is_sink) process_sink_orphan(o);
+                    else process_source_orphan(o);
+                }
+            }
+            orphans_front.clear();
+        }
+        else
+            current = -1;
+    }
+    return flow;
+}
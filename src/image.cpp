@@ -47,14 +47,15 @@ double NCC(const Image<float>& I1,Point m1,const Image<float>& I2,Point m2,int n
 // ===========================================================
 
 // Correlation with pre-computed means
+// the window sums are read from the integral image, 0 where the window is not inside the image
 Image<float> meanImage(const Image<float>& I,int n) {
 	Image<float> meanI(I.width(),I.height(),CV_32F);
+	meanI.setTo(0);
+	Image<double> S;
+	integral(I,S,CV_64F);
 	for (int j=n;j<I.height()-n;j++) {
 		for (int i=n;i<I.width()-n;i++) {
-			double s=0;
-			for (int dj=-n;dj<=n;dj++)
-				for (int di=-n;di<=n;di++) 
-					s+=I(i+di,j+dj);
+			double s=S(i+n+1,j+n+1)-S(i-n,j+n+1)-S(i+n+1,j-n)+S(i-n,j-n);
 			meanI(i,j)=float(s/(2*n+1)/(2*n+1));
 		}
 	}
@@ -83,3 +84,93 @@ double NCC(const Image<float>& I1,const Image<float>& meanI1,Point m1,const Imag
 	return corr(I1,meanI1,m1,I2,meanI2,m2,n)/sqrt(c1*c2);
 }
 
+// ===========================================================
+
+// Correlation with integral images
+NCCImage::NCCImage(const Image<float>& I,int n):I(I),n(n) {
+	integral(I,S,S2,CV_64F,CV_64F);
+}
+
+// NCC from the sums over the windows: sxy, sx, sy, sxx, syy, with N points
+static double nccFromSums(double sxy,double sx,double sy,double sxx,double syy,double N) {
+	double c1=sxx-sx*sx/N;
+	if (c1<=0) return -1;
+	double c2=syy-sy*sy/N;
+	if (c2<=0) return -1;
+	return (sxy-sx*sy/N)/sqrt(c1*c2);
+}
+
+double NCC(const NCCImage& I1,Point m1,const NCCImage& I2,Point m2) {
+	int n=I1.halfSize();
+	if (!I1.inside(m1) || !I2.inside(m2)) return -1;
+	double sxy=0;
+	for (int j=-n;j<=n;j++) {
+		const float* r1=I1.image().ptr<float>(m1.y+j)+m1.x;
+		const float* r2=I2.image().ptr<float>(m2.y+j)+m2.x;
+		for (int i=-n;i<=n;i++)
+			sxy+=double(r1[i])*r2[i];
+	}
+	double N=(2*n+1)*(2*n+1);
+	return nccFromSums(sxy,I1.sum(m1),I2.sum(m2),I1.sum2(m1),I2.sum2(m2),N);
+}
+
+Image<float> NCC(const NCCImage& I1,const NCCImage& I2,Point d) {
+	const Image<float>& J1=I1.image();
+	const Image<float>& J2=I2.image();
+	int n=I1.halfSize();
+	Image<float> R(J1.width(),J1.height(),CV_32F);
+	R.setTo(-1);
+	// the points m of I1 with m-d in I2
+	Rect r=Rect(0,0,J1.width(),J1.height()) & Rect(d.x,d.y,J2.width(),J2.height());
+	if (r.width<=2*n || r.height<=2*n) return R;
+	// products of the two images over that rectangle, and their window sums
+	Mat P;
+	multiply(Mat(J1,r),Mat(J2,r-d),P,1,CV_64F);
+	Image<double> SP;
+	integral(P,SP,CV_64F);
+	double N=(2*n+1)*(2*n+1);
+	for (int y=r.y+n;y<r.y+r.height-n;y++)
+		for (int x=r.x+n;x<r.x+r.width-n;x++) {
+			int u=x-r.x, v=y-r.y;
+			double sxy=SP(u+n+1,v+n+1)-SP(u-n,v+n+1)-SP(u+n+1,v-n)+SP(u-n,v-n);
+			Point m(x,y);
+			R(x,y)=float(nccFromSums(sxy,I1.sum(m),I2.sum(m-d),I1.sum2(m),I2.sum2(m-d),N));
+		}
+	return R;
+}
+
+Image<float> NCC(const Image<float>& I,const Image<float>& T) {
+	int w=I.width()-T.width()+1, h=I.height()-T.height()+1;
+	if (w<=0 || h<=0) return Image<float>();
+	// template with zero mean: its correlation with I is the numerator of the NCC
+	Scalar meanT,stdT;
+	meanStdDev(T,meanT,stdT);
+	double N=T.width()*T.height();
+	double normT=stdT[0]*stdT[0]*N;
+	Mat T0;
+	T.convertTo(T0,CV_32F,1,-meanT[0]);
+
+	// correlation by FFT, the images padded to a fast size
+	int dw=getOptimalDFTSize(I.width()), dh=getOptimalDFTSize(I.height());
+	Mat FI,FT,padI,padT;
+	copyMakeBorder(I,padI,0,dh-I.height(),0,dw-I.width(),BORDER_CONSTANT,Scalar(0));
+	copyMakeBorder(T0,padT,0,dh-T.height(),0,dw-T.width(),BORDER_CONSTANT,Scalar(0));
+	dft(padI,FI,0,I.height());
+	dft(padT,FT,0,T.height());
+	mulSpectrums(FI,FT,FI,0,true);
+	Mat C;
+	idft(FI,C,DFT_SCALE|DFT_REAL_OUTPUT,h);
+
+	Image<double> S,S2;
+	integral(I,S,S2,CV_64F,CV_64F);
+	Image<float> R(w,h,CV_32F);
+	for (int y=0;y<h;y++)
+		for (int x=0;x<w;x++) {
+			int x1=x+T.width(), y1=y+T.height();
+			double s=S(x1,y1)-S(x,y1)-S(x1,y)+S(x,y);
+			double s2=S2(x1,y1)-S2(x,y1)-S2(x1,y)+S2(x,y);
+			double c=(s2-s*s/N)*normT;
+			R(x,y)=(c>0) ? float(C.at<float>(y,x)/sqrt(c)) : -1.f;
+		}
+	return R;
+}
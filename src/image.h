@@ -42,4 +42,35 @@ double NCC(const Image<float>& I1,Point m1,const Image<float>& I2,Point m2,int n
 Image<float> meanImage(const Image<float>& I,int n);
 double NCC(const Image<float>& I1,const Image<float>& meanI1,Point m1,const Image<float>& I2,const Image<float>& meanI2,Point m2,int n);
 
+// Correlation with integral images: the sums of the values and of their squares over any window
+// are read in constant time, for images compared many times with the same window size
+class NCCImage {
+public:
+	NCCImage() : n(0) {}
+	NCCImage(const Image<float>& I,int n);
+	// sums over the window of half size n centered at m
+	double sum(Point m) const { return boxSum(S,m); }
+	double sum2(Point m) const { return boxSum(S2,m); }
+	// the window of half size n centered at m is inside the image
+	bool inside(Point m) const { return m.x>=n && m.x<I.width()-n && m.y>=n && m.y<I.height()-n; }
+	const Image<float>& image() const { return I; }
+	int halfSize() const { return n; }
+private:
+	Image<float> I;
+	Image<double> S,S2;
+	int n;
+	double boxSum(const Image<double>& T,Point m) const {
+		return T(m.x+n+1,m.y+n+1)-T(m.x-n,m.y+n+1)-T(m.x+n+1,m.y-n)+T(m.x-n,m.y-n);
+	}
+};
+// same value as NCC(I1,m1,I2,m2,n), the means and norms taken from the integral images
+double NCC(const NCCImage& I1,Point m1,const NCCImage& I2,Point m2);
+// dense NCC for the translation d: NCC(I1,m,I2,m-d) at each point m of I1, -1 where a window is not inside
+// both images. Costs O(1) per point, whatever the window size.
+Image<float> NCC(const NCCImage& I1,const NCCImage& I2,Point d);
+// NCC of the template T at every place of I: the value at p compares T with the window of I whose top-left corner
+// is p ((I.width()-T.width()+1)x(I.height()-T.height()+1) values, -1 where the window of I is flat).
+// The correlations are computed by FFT, the cost does not depend on the size of T.
+Image<float> NCC(const Image<float>& I,const Image<float>& T);
+
 
@@ -0,0 +1,109 @@
+#include "imageStream.h"
+
+#include <iostream>
+#include <cstdio>
+
+using namespace std;
+
+// next number of the header, skipping the comments
+static bool readHeaderValue(ifstream& in, int& value){
+    in >> ws;
+    while(in.peek()=='#'){
+        string comment;
+        getline(in, comment);
+        in >> ws;
+    }
+    return bool(in >> value);
+}
+
+bool PPMReader::open(const string& filename){
+    in.open(filename.c_str(), ios::binary);
+    if(!in){
+        cout << "could not open " << filename << endl;
+        return false;
+    }
+    string magic;
+    in >> magic;
+    int maxval;
+    if((magic!="P6" && magic!="P5") || !readHeaderValue(in, w) || !readHeaderValue(in, h) || !readHeaderValue(in, maxval) || maxval!=255){
+        cout << filename << " is not an 8 bit binary PPM or PGM file" << endl;
+        return false;
+    }
+    in.get(); // single white space before the samples
+    channels = (magic=="P6") ? 3 : 1;
+    data = in.tellg();
+    return true;
+}
+
+bool PPMReader::read(const Rect& r, Image<Vec3b>& I){
+    if(channels!=3 || r.x<0 || r.y<0 || r.x+r.width>w || r.y+r.height>h){
+        cout << "wrong rectangle read from a PPM file" << endl;
+        return false;
+    }
+    I = Image<Vec3b>(r.width, r.height, DataType<Vec3b>::type);
+    for(int y=0; y<r.height; y++){
+        in.seekg(data + (streamoff(r.y+y)*w + r.x)*3);
+        Vec3b* row = I.ptr<Vec3b>(y);
+        if(!in.read((char*)row, streamsize(r.width)*3))
+            return false;
+        for(int x=0; x<r.width; x++)
+            swap(row[x][0], row[x][2]);
+    }
+    return true;
+}
+
+bool PPMWriter::open(const string& filename, int width, int height, int c){
+    out.open(filename.c_str(), ios::binary);
+    if(!out){
+        cout << "could not write " << filename << endl;
+        return false;
+    }
+    w = width;
+    channels = c;
+    out << (channels==3 ? "P6" : "P5") << "\n" << width << " " << height << "\n255\n";
+    buffer.resize(size_t(w)*channels);
+    return bool(out);
+}
+
+bool PPMWriter::writeRow(const void* row){
+    const uchar* p = (const uchar*)row;
+    if(channels==3){
+        for(int x=0; x<w; x++){
+            buffer[3*x] = p[3*x+2];
+            buffer[3*x+1] = p[3*x+1];
+            buffer[3*x+2] = p[3*x];
+        }
+        p = &buffer[0];
+    }
+    return bool(out.write((const char*)p, streamsize(w)*channels));
+}
+
+bool ByteSpool::open(const string& filename, int width){
+    close();
+    file.open(filename.c_str(), ios::in | ios::out | ios::trunc | ios::binary);
+    if(!file){
+        cout << "could not write " << filename << endl;
+        return false;
+    }
+    name = filename;
+    w = width;
+    return true;
+}
+
+bool ByteSpool::write(int x, int y, const uchar* p, int n){
+    file.seekp(streamoff(y)*w + x);
+    return bool(file.write((const char*)p, n));
+}
+
+bool ByteSpool::readRow(int y, uchar* p){
+    file.seekg(streamoff(y)*w);
+    return bool(file.read((char*)p, w));
+}
+
+void ByteSpool::close(){
+    if(name.empty())
+        return;
+    file.close();
+    remove(name.c_str());
+    name.clear();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "image.h"
+#include <fstream>
+#include <string>
+
+// Binary PPM (P6) and PGM (P5) files read and written a few rows at a time, for images that do not fit in memory.
+// The samples are 8 bits (maxval 255). Colors are converted between the RGB order of the file and the BGR order of OpenCV.
+
+class PPMReader {
+public:
+    PPMReader() : w(0), h(0), channels(0) {}
+    // reads the header, returns false if the file is not an 8 bit P6 or P5 file
+    bool open(const std::string& filename);
+    int width() const { return w; }
+    int height() const { return h; }
+    Size size() const { return Size(w, h); }
+    // reads the rectangle r of a P6 file into I (r must lie inside the image)
+    bool read(const Rect& r, Image<Vec3b>& I);
+private:
+    std::ifstream in;
+    std::streamoff data; // position of the first sample
+    int w, h, channels;
+};
+
+class PPMWriter {
+public:
+    PPMWriter() : w(0), channels(0) {}
+    // writes the header of a P6 (3 channels) or P5 (1 channel) file
+    bool open(const std::string& filename, int width, int height, int channels);
+    // appends the next row, w samples of Vec3b for P6 or uchar for P5
+    bool writeRow(const void* row);
+private:
+    std::ofstream out;
+    std::vector<uchar> buffer;
+    int w, channels;
+};
+
+// Temporary file of w x h bytes, written in any order and read back row by row, for labels too large for memory.
+// The file is removed by close() and by the destructor.
+class ByteSpool {
+public:
+    ByteSpool() : w(0) {}
+    ~ByteSpool() { close(); }
+    bool open(const std::string& filename, int width);
+    // writes n bytes at (x,y)
+    bool write(int x, int y, const uchar* p, int n);
+    // reads the row y
+    bool readRow(int y, uchar* p);
+    void close();
+private:
+    ByteSpool(const ByteSpool&);
+    ByteSpool& operator=(const ByteSpool&);
+    std::fstream file;
+    std::string name;
+    int w;
+};
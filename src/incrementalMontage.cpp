@@ -0,0 +1,167 @@
+#include "incrementalMontage.h"
+
+#include <cmath>
+
+IncrementalMontage::IncrementalMontage() : G(NULL) {}
+
+IncrementalMontage::~IncrementalMontage(){
+    delete G;
+}
+
+void IncrementalMontage::clear(){
+    delete G;
+    G = NULL;
+    I1color.release();
+    I2color.release();
+    G1.release();
+    G2.release();
+}
+
+// t-link of a point of the overlap as stored by the graph: capacity to the source minus capacity to the sink
+static double pinCapacity(uchar constraint, double pin){
+    if(constraint==POINT_FIRST_IMAGE) return pin;
+    if(constraint==POINT_SECOND_IMAGE) return -pin;
+    return 0;
+}
+
+void IncrementalMontage::build(const MontageParams& params){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    delta = params.delta;
+    lambda = params.lambda;
+    constraints = overlapConstraints(overlap, right_order1, right_order2, type, delta);
+    nodes = Image<int>(w, h, CV_32S);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++)
+            nodes(x,y) = x+y*w;
+    computeSeamCosts(overlap, I1color, I2color, G1, G2, offset1, offset2, lambda, max_lambda, horizontal, vertical);
+
+    // an edge weighs at most 2*||(255,255,255)|| whatever lambda is, so a t-link larger than the sum of all
+    // the edges is never cut. Unlike INF, it leaves enough precision to add and remove it from the residual t-links.
+    int edge_num = (w-1)*h + w*(h-1);
+    pin = 1 + 2*255*sqrt(3.)*edge_num;
+
+    delete G;
+    G = new GraphType(w*h, edge_num);
+    G->add_node(w*h);
+    // the edges are added in this order, updateWeights goes through the arcs in the same one
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++){
+            if(x<w-1)
+                G->add_edge(nodes(x,y), nodes(x+1,y), horizontal(x,y), horizontal(x,y));
+            if(y<h-1)
+                G->add_edge(nodes(x,y), nodes(x,y+1), vertical(x,y), vertical(x,y));
+        }
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++){
+            double t = pinCapacity(constraints(x,y), pin);
+            if(t!=0)
+                G->add_tweights(nodes(x,y), max(t,0.), max(-t,0.));
+        }
+    G->maxflow();
+}
+
+// Changes the capacity of the edge i-j from c to c2 in the residual graph. The flow f going from i to j through the edge
+// is kept when possible (residual capacities c2-f and c2+f). If |f| exceeds c2, the flow is reduced to c2 and the excess
+// is given back to the t-links of i and j, which changes the energy by a constant only.
+static void changeEdge(Graph<double,double,double>& G, Graph<double,double,double>::arc_id a, int i, int j, double c, double c2){
+    if(c==c2)
+        return;
+    Graph<double,double,double>::arc_id b = G.get_next_arc(a); // the reverse arc is added right after
+    double r = G.get_rcap(a) + (c2-c), rs = G.get_rcap(b) + (c2-c);
+    if(r<0){
+        G.set_trcap(i, G.get_trcap(i)-r);
+        G.set_trcap(j, G.get_trcap(j)+r);
+        rs += r;
+        r = 0;
+    }
+    else if(rs<0){
+        G.set_trcap(j, G.get_trcap(j)-rs);
+        G.set_trcap(i, G.get_trcap(i)+rs);
+        r += rs;
+        rs = 0;
+    }
+    G.set_rcap(a, r);
+    G.set_rcap(b, rs);
+    G.mark_node(i);
+    G.mark_node(j);
+}
+
+void IncrementalMontage::updateWeights(const MontageParams& params){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    Image<float> horizontal2, vertical2;
+    computeSeamCosts(overlap, I1color, I2color, G1, G2, offset1, offset2, params.lambda, max_lambda, horizontal2, vertical2);
+    GraphType::arc_id a = G->get_first_arc();
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++){
+            if(x<w-1){
+                changeEdge(*G, a, nodes(x,y), nodes(x+1,y), horizontal(x,y), horizontal2(x,y));
+                a = G->get_next_arc(G->get_next_arc(a));
+            }
+            if(y<h-1){
+                changeEdge(*G, a, nodes(x,y), nodes(x,y+1), vertical(x,y), vertical2(x,y));
+                a = G->get_next_arc(G->get_next_arc(a));
+            }
+        }
+    horizontal = horizontal2;
+    vertical = vertical2;
+    lambda = params.lambda;
+}
+
+void IncrementalMontage::updateConstraints(const MontageParams& params){
+    Image<uchar> constraints2 = overlapConstraints(overlap, right_order1, right_order2, type, params.delta);
+    for(int y=0; y<constraints.height(); y++)
+        for(int x=0; x<constraints.width(); x++)
+            if(constraints2(x,y)!=constraints(x,y)){
+                int i = nodes(x,y);
+                G->set_trcap(i, G->get_trcap(i) + pinCapacity(constraints2(x,y), pin) - pinCapacity(constraints(x,y), pin));
+                G->mark_node(i);
+            }
+    constraints = constraints2;
+    delta = params.delta;
+}
+
+double IncrementalMontage::cutCost() const{
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    double cost = 0;
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++){
+            bool s = G->what_segment(nodes(x,y))==GraphType::SOURCE;
+            if(x<w-1 && s!=(G->what_segment(nodes(x+1,y))==GraphType::SOURCE))
+                cost += horizontal(x,y);
+            if(y<h-1 && s!=(G->what_segment(nodes(x,y+1))==GraphType::SOURCE))
+                cost += vertical(x,y);
+        }
+    return cost;
+}
+
+double IncrementalMontage::update(const Image<Vec3b>&I1, const Image<Vec3b>&I2, Point o1, Point o2, Image<Vec3b>&montage, Image<float>&cut, const MontageParams& params, GradientCache* cache){
+    bool same_graph = G && I1.data==I1color.data && I2.data==I2color.data && I1.size()==I1color.size() && I2.size()==I2color.size()
+        && o1==offset1 && o2==offset2 && params.type==type && params.blur_image==blur_image && params.max_lambda==max_lambda;
+    if(!same_graph){
+        if(!prepareMontage(I1, I2, o1, o2, params, cache, rec, overlap, right_order1, right_order2, G1, G2)){
+            clear();
+            return -1;
+        }
+        I1color = I1;
+        I2color = I2;
+        offset1 = o1;
+        offset2 = o2;
+        type = params.type;
+        blur_image = params.blur_image;
+        max_lambda = params.max_lambda;
+        build(params);
+    }
+    else if(params.lambda!=lambda || params.delta!=delta){
+        if(params.lambda!=lambda)
+            updateWeights(params);
+        if(params.delta!=delta)
+            updateConstraints(params);
+        G->maxflow(true);
+    }
+
+    montage = Image<Vec3b>(rec.p2.x-rec.p1.x,rec.p2.y-rec.p1.y, DataType<Vec3b>::type);
+    cut = Image<float>(rec.p2.x-rec.p1.x,rec.p2.y-rec.p1.y, DataType<float>::type);
+    generateImagesFromGraphAndRec(montage, cut, *G, rec, overlap, constraints, nodes, right_order1, right_order2, I1color, I2color, offset1, offset2, type);
+    // the flow returned by maxflow is not valid after the capacities were changed, the cost is computed from the cut
+    return cutCost();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "photomontage.h"
+
+// Montage that keeps its graph between updates, for the interactive mode.
+// When the images, offsets, type and blur flag are the same as in the previous update and only lambda or delta changed,
+// the capacities of the graph are updated in place and the cut is computed again reusing the search trees of the
+// previous maxflow (Kohli and Torr, see maxflow/graph.h). Otherwise the graph is built again.
+//
+// All the points of the overlap are nodes of the graph, the points fixed by delta are pinned to their image with
+// a t-link larger than any cut, so that changing delta only changes t-links.
+// The capacities are always doubles and the whole overlap is solved (MontageParams::capacity and pyramid_levels are not used).
+class IncrementalMontage {
+public:
+    IncrementalMontage();
+    ~IncrementalMontage();
+
+    // same as photomontage()
+    double update(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, Image<Vec3b>&montage, Image<float>&cut, const MontageParams& params = MontageParams(), GradientCache* cache = NULL);
+
+    // forgets the graph, the next update builds it again
+    void clear();
+
+private:
+    IncrementalMontage(const IncrementalMontage&);
+    IncrementalMontage& operator=(const IncrementalMontage&);
+
+    void build(const MontageParams& params);
+    void updateWeights(const MontageParams& params);
+    void updateConstraints(const MontageParams& params);
+    // cost of the cut given by the current segmentation
+    double cutCost() const;
+
+    typedef Graph<double,double,double> GraphType;
+    GraphType* G;
+
+    // what the graph was built for
+    Image<Vec3b> I1color, I2color;
+    Point offset1, offset2;
+    int type, max_lambda;
+    bool blur_image;
+    Rectangle rec, overlap;
+    bool right_order1, right_order2;
+    Image<float> G1, G2;
+
+    // current state of the capacities
+    int delta, lambda;
+    Image<uchar> constraints;
+    Image<int> nodes;
+    Image<float> horizontal, vertical;
+    double pin; // capacity of the t-links of the fixed points
+};
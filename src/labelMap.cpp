@@ -0,0 +1,217 @@
+#include "labelMap.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+static const char magic[4] = {'P', 'M', 'L', 'M'};
+static const char version = 1;
+
+static void putVarint(vector<uchar>& buffer, unsigned v){
+    while(v>=0x80){
+        buffer.push_back(uchar(v|0x80));
+        v >>= 7;
+    }
+    buffer.push_back(uchar(v));
+}
+
+static bool getVarint(istream& in, unsigned& v){
+    v = 0;
+    for(int shift=0; shift<35; shift+=7){
+        int c = in.get();
+        if(c==EOF)
+            return false;
+        v |= unsigned(c&0x7f)<<shift;
+        if(!(c&0x80))
+            return true;
+    }
+    return false;
+}
+
+// signed values as varints: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+static unsigned zigzag(int v){
+    return (unsigned(v)<<1)^unsigned(v>>31);
+}
+
+static int unzigzag(unsigned v){
+    return int(v>>1)^-int(v&1);
+}
+
+bool LabelMapWriter::open(int width, int height, Point origin){
+    close();
+    out.open(name.c_str(), ios::binary);
+    if(!out){
+        cout << "could not write " << name << endl;
+        return false;
+    }
+    w = width;
+    h = height;
+    rows = 0;
+    buffer.clear();
+    buffer.insert(buffer.end(), magic, magic+4);
+    buffer.push_back(version);
+    putVarint(buffer, w);
+    putVarint(buffer, h);
+    putVarint(buffer, zigzag(origin.x));
+    putVarint(buffer, zigzag(origin.y));
+    out.write((const char*)&buffer[0], buffer.size());
+    previous.assign(w, 0);
+    vertical_start.assign(w+1, -1);
+    if(!seam_name.empty()){
+        seam_out.open(seam_name.c_str());
+        if(!seam_out){
+            cout << "could not write " << seam_name << endl;
+            out.close();
+            return false;
+        }
+        seam_out << "seam " << w << " " << h << "\n";
+    }
+    return bool(out);
+}
+
+void LabelMapWriter::closeVertical(int x, int y){
+    if(vertical_start[x]<0)
+        return;
+    seam_out << x << " " << vertical_start[x] << " " << x << " " << y << "\n";
+    vertical_start[x] = -1;
+}
+
+bool LabelMapWriter::writeRow(const uchar* labels){
+    if(!out.is_open() || rows>=h)
+        return false;
+    // lengths of the runs, starting with a run of 0
+    buffer.clear();
+    vector<unsigned> runs;
+    uchar current = 0;
+    int start = 0;
+    for(int x=0; x<w; x++){
+        uchar l = labels[x]!=0;
+        if(l!=current){
+            runs.push_back(x-start);
+            start = x;
+            current = l;
+        }
+    }
+    runs.push_back(w-start);
+    putVarint(buffer, (unsigned)runs.size());
+    for(size_t k=0; k<runs.size(); k++)
+        putVarint(buffer, runs[k]);
+    out.write((const char*)&buffer[0], buffer.size());
+
+    if(seam_out.is_open()){
+        // vertical segments between x-1 and x go on while the labels differ there
+        for(int x=1; x<w; x++){
+            bool boundary = (labels[x]!=0)!=(labels[x-1]!=0);
+            if(boundary && vertical_start[x]<0)
+                vertical_start[x] = rows;
+            else if(!boundary)
+                closeVertical(x, rows);
+        }
+        // horizontal segments between this row and the previous one
+        for(int x=0; rows>0 && x<w; ){
+            if((labels[x]!=0)==(previous[x]!=0)){
+                x++;
+                continue;
+            }
+            int x0 = x;
+            while(x<w && (labels[x]!=0)!=(previous[x]!=0))
+                x++;
+            seam_out << x0 << " " << rows << " " << x << " " << rows << "\n";
+        }
+        for(int x=0; x<w; x++)
+            previous[x] = labels[x]!=0;
+    }
+    rows++;
+    if(!out){
+        cout << "could not write " << name << endl;
+        return false;
+    }
+    return true;
+}
+
+bool LabelMapWriter::close(){
+    if(!out.is_open())
+        return true;
+    if(seam_out.is_open()){
+        for(int x=1; x<w; x++)
+            closeVertical(x, rows);
+        seam_out.close();
+    }
+    bool complete = rows==h && bool(out);
+    out.close();
+    if(!complete)
+        cout << name << " is incomplete: " << rows << " rows of " << h << endl;
+    return complete;
+}
+
+// The rows of the file are decoded in order; each row of the result takes the source row its center falls in, and
+// each point the label of the source point its center falls in.
+bool readLabelMap(const string& filename, Image<uchar>& labels, double scale, Point* origin){
+    ifstream in(filename.c_str(), ios::binary);
+    if(!in){
+        cout << "could not open " << filename << endl;
+        return false;
+    }
+    char header[5];
+    unsigned w, h, x0, y0;
+    if(!in.read(header, 5) || !equal(magic, magic+4, header) || header[4]!=version || !getVarint(in, w) || !getVarint(in, h) || !getVarint(in, x0) || !getVarint(in, y0)){
+        cout << filename << " is not a label map" << endl;
+        return false;
+    }
+    if(!(scale>0)){
+        cout << "wrong scale " << scale << endl;
+        return false;
+    }
+    // the sizes and the origin come from the file: checked before anything is allocated
+    const double max_int = numeric_limits<int>::max();
+    if(w==0 || h==0 || w>max_int || h>max_int || w*scale+0.5>max_int || h*scale+0.5>max_int){
+        cout << filename << " has a wrong size " << w << "x" << h << " at scale " << scale << endl;
+        return false;
+    }
+    if(fabs(unzigzag(x0)*scale)+0.5>max_int || fabs(unzigzag(y0)*scale)+0.5>max_int){
+        cout << filename << " has a wrong origin at scale " << scale << endl;
+        return false;
+    }
+    if(origin)
+        *origin = Point((int)floor(unzigzag(x0)*scale+0.5), (int)floor(unzigzag(y0)*scale+0.5));
+    int W = max(1, (int)floor(w*scale+0.5)), H = max(1, (int)floor(h*scale+0.5));
+    labels = Image<uchar>(W, H, CV_8U);
+    // source column of each column of the result
+    vector<int> column(W);
+    for(int X=0; X<W; X++)
+        column[X] = min((int)((X+0.5)/scale), (int)w-1);
+
+    vector<uchar> row(w);
+    int y = -1;
+    for(int Y=0; Y<H; Y++){
+        int source = min((int)((Y+0.5)/scale), (int)h-1);
+        while(y<source){
+            unsigned n, length;
+            if(!getVarint(in, n)){
+                cout << filename << " is truncated" << endl;
+                return false;
+            }
+            unsigned x = 0;
+            for(unsigned k=0; k<n; k++){
+                if(!getVarint(in, length) || length>w-x){
+                    cout << filename << " is corrupted" << endl;
+                    return false;
+                }
+                fill(row.begin()+x, row.begin()+x+length, uchar(k%2));
+                x += length;
+            }
+            if(x!=w){
+                cout << filename << " is corrupted" << endl;
+                return false;
+            }
+            y++;
+        }
+        uchar* out = labels.ptr<uchar>(Y);
+        for(int X=0; X<W; X++)
+            out[X] = row[column[X]];
+    }
+    return true;
+}
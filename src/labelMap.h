@@ -0,0 +1,45 @@
+#pragma once
+
+#include "image.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Label map of a montage on disk, written a row at a time: 1 where the point comes from the first image, 0 otherwise.
+//
+// The file is "PMLM", a version byte, the width, the height and the place of the top left point on the canvas of the
+// images (x then y, zigzag encoded), then for each row the number of runs followed by
+// their lengths, all as LEB128 varints. The runs alternate between 0 and 1 starting with 0 (the first one is empty
+// when the row starts with 1), so a row crossed once by the seam takes a few bytes whatever its width.
+//
+// The optional seam file is text: "seam width height", then one "x0 y0 x1 y1" line per segment of the seam, in the
+// coordinates of the corners of the points (the point (x,y) is the square from (x,y) to (x+1,y+1)). Vertical segments
+// separate points of a row, horizontal ones points of consecutive rows; each is as long as possible.
+class LabelMapWriter {
+public:
+    // the files are created by open(), when the size of the montage is known; no seam file when seam is empty
+    LabelMapWriter(const std::string& filename, const std::string& seam = "") : name(filename), seam_name(seam), w(0), h(0), rows(0) {}
+    ~LabelMapWriter() { close(); }
+    // writes the header of the label map and of the seam file, origin being the place of the map on the canvas
+    bool open(int width, int height, Point origin = Point(0,0));
+    bool isOpen() const { return out.is_open(); }
+    // appends the next row, width labels (any non-zero value is 1)
+    bool writeRow(const uchar* labels);
+    // writes the segments still open, returns false if some rows are missing
+    bool close();
+private:
+    std::ofstream out, seam_out;
+    std::string name, seam_name;
+    int w, h, rows;
+    std::vector<uchar> previous;     // labels of the last row
+    std::vector<int> vertical_start; // for each x, first row of the vertical segment open at x, or -1
+    std::vector<uchar> buffer;
+
+    void closeVertical(int x, int y);
+};
+
+// Reads a label map written by LabelMapWriter into labels, resized by scale (nearest point): the label map of a montage
+// computed at one resolution composites it at another one. origin receives the place of the map on the canvas, also
+// scaled. The rows are decoded one at a time. Returns false, before allocating labels, when the map is empty or its
+// size or origin at this scale does not fit in an int.
+bool readLabelMap(const std::string& filename, Image<uchar>& labels, double scale = 1, Point* origin = NULL);
@@ -0,0 +1,206 @@
+#include "maskMontage.h"
+#include "seamCost.h"
+#include "parallel.h"
+#include "parallelGraph.h"
+#include "graphPool.h"
+
+#include <iostream>
+
+using namespace std;
+
+TranslatedSource::TranslatedSource(const Image<Vec3b>& image, Point offset, Size canvas, bool blur_image, GradientCache* cache) : image(image), offset(offset) {
+    if(cache)
+        G = cache->gradient(image, blur_image);
+    else{
+        G = Image<float>(image.width(), image.height(), CV_32F);
+        computeGradient(image, G, blur_image);
+    }
+    M = RunMask::rectangle(canvas, Rect(offset.x, offset.y, image.width(), image.height()));
+}
+
+HomographySource::HomographySource(const Image<Vec3b>& image, const Matx33d& H, Size canvas, bool blur_image, GradientCache* cache) : image(image), H_inv(H.inv()) {
+    if(cache)
+        G = cache->gradient(image, blur_image);
+    else{
+        G = Image<float>(image.width(), image.height(), CV_32F);
+        computeGradient(image, G, blur_image);
+    }
+    // the centers of the corner pixels, so that the points of the mask have four neighbours to interpolate
+    double w = image.width()-1, h = image.height()-1;
+    vector<Point2d> corners;
+    corners.push_back(project(H, 0, 0));
+    corners.push_back(project(H, w, 0));
+    corners.push_back(project(H, w, h));
+    corners.push_back(project(H, 0, h));
+    M = RunMask::convexPolygon(canvas, corners);
+}
+
+Point2d HomographySource::project(const Matx33d& H, double x, double y){
+    Vec3d p = H*Vec3d(x, y, 1);
+    return Point2d(p[0]/p[2], p[1]/p[2]);
+}
+
+Point2d HomographySource::source(int x, int y) const {
+    Point2d p = project(H_inv, x, y);
+    p.x = min(max(p.x, 0.), image.width()-1.);
+    p.y = min(max(p.y, 0.), image.height()-1.);
+    return p;
+}
+
+Vec3b HomographySource::color(int x, int y) const {
+    Point2d p = source(x, y);
+    int i = min((int)p.x, image.width()-2), j = min((int)p.y, image.height()-2);
+    if(i<0 || j<0)
+        return image(max(i,0), max(j,0));
+    double a = p.x-i, b = p.y-j;
+    const Vec3b &c00 = image(i,j), &c10 = image(i+1,j), &c01 = image(i,j+1), &c11 = image(i+1,j+1);
+    Vec3b c;
+    for(int k=0; k<3; k++)
+        c[k] = saturate_cast<uchar>((1-b)*((1-a)*c00[k]+a*c10[k]) + b*((1-a)*c01[k]+a*c11[k]));
+    return c;
+}
+
+float HomographySource::gradient(int x, int y) const {
+    Point2d p = source(x, y);
+    int i = min((int)p.x, G.width()-2), j = min((int)p.y, G.height()-2);
+    if(i<0 || j<0)
+        return G(max(i,0), max(j,0));
+    double a = p.x-i, b = p.y-j;
+    return float((1-b)*((1-a)*G(i,j)+a*G(i+1,j)) + b*((1-a)*G(i,j+1)+a*G(i+1,j+1)));
+}
+
+// the masks of a two-source montage: the intersection, its points fixed to each source and its free points
+namespace {
+struct MaskOverlap {
+    RunMask intersection, first, second, free;
+    vector<float> cost; // cost of each point of the intersection, by rank
+};
+}
+
+// Labels the free points (1 where the point comes from S1) from a minimum cut of the graph over them.
+// Each free point p gets an edge towards its free neighbours right and below, and a t-link for each fixed neighbour;
+// the weight of the edge p,q is cost(p)+cost(q). Neighbours outside the intersection have no edge.
+template <typename captype, typename tcaptype, typename flowtype>
+static double solveMaskMontage(const MaskOverlap& O, const MontageParams& params, vector<uchar>& labels){
+    const RunMask& F = O.free;
+    int node_num = F.area();
+    typename GraphPool<captype,tcaptype,flowtype>::GraphPtr G = graphPool<captype,tcaptype,flowtype>().acquire(node_num, 2*node_num);
+    G->add_node(node_num);
+    double scale = capacityScale<captype>(params.capacity_scale);
+    auto weight = [&](int i, int x, int y) { return quantizeWeight<captype>(O.cost[i]+O.cost[O.intersection.index(x,y)], scale); };
+    for(int y=0; y<F.height(); y++)
+        for(int k=0; k<F.runs(y); k++){
+            const RunMask::Run& r = F.run(y,k);
+            for(int x=r.x0; x<r.x1; x++){
+                int u = F.runRank(y,k)+x-r.x0, i = O.intersection.index(x,y);
+                const Point neighbours[4] = {Point(x+1,y), Point(x,y+1), Point(x-1,y), Point(x,y-1)};
+                tcaptype t[3] = {0, 0, 0};
+                for(int d=0; d<4; d++){
+                    Point q = neighbours[d];
+                    if(!O.intersection.contains(q))
+                        continue;
+                    int v = F.index(q);
+                    if(v>=0){
+                        // each edge between free points once, from its left or top end
+                        if(d<2){
+                            captype c = weight(i, q.x, q.y);
+                            G->add_edge(u, v, c, c);
+                        }
+                    }
+                    else
+                        t[O.first.contains(q) ? POINT_FIRST_IMAGE : POINT_SECOND_IMAGE] += weight(i, q.x, q.y);
+                }
+                if(t[POINT_FIRST_IMAGE]!=0 || t[POINT_SECOND_IMAGE]!=0)
+                    G->add_tweights(u, t[POINT_FIRST_IMAGE], t[POINT_SECOND_IMAGE]);
+            }
+        }
+    double flow = (params.solver==SOLVER_PARALLEL) ? parallelMaxflow(*G) : G->maxflow();
+    labels.resize(node_num);
+    for(int u=0; u<node_num; u++)
+        labels[u] = G->what_segment(u)==Graph<captype,tcaptype,flowtype>::SOURCE;
+    if(numeric_limits<captype>::is_integer)
+        flow /= scale;
+    return flow;
+}
+
+double maskPhotomontage(const CanvasSource& S1, const CanvasSource& S2, Image<Vec3b>& montage, Image<float>& cut, Point& origin, const MontageParams& params){
+    const RunMask& M1 = S1.mask();
+    const RunMask& M2 = S2.mask();
+    if(M1.size()!=M2.size()){
+        cout << "the sources are not on the same canvas" << endl;
+        return -1;
+    }
+    MaskOverlap O;
+    O.intersection = M1 & M2;
+    if(O.intersection.empty()){
+        cout << "the images do not overlap" << endl;
+        return -1;
+    }
+    RunMask only1 = M1-M2, only2 = M2-M1;
+    RunMask near1 = only1.dilate(params.delta) & O.intersection, near2 = only2.dilate(params.delta) & O.intersection;
+    O.first = near1-near2;
+    O.second = near2-near1;
+    O.free = O.intersection-O.first-O.second;
+
+    // cost of the points of the intersection, run by run
+    int max_lambda = params.max_lambda, lambda = params.lambda;
+    if(max_lambda==0){
+        cout << "max_lambda was set to 0, but was supposed to be constant and greater than zero." << endl;
+        max_lambda = 1;
+        lambda = 0;
+    }
+    float wc = float(max_lambda-lambda)/max_lambda, wg = float(lambda)/max_lambda;
+    const RunMask& I = O.intersection;
+    O.cost.resize(I.area());
+    int h = I.height(), bands = max(1, min(h, parallelThreads()));
+    parallelFor(bands, [&](int b) {
+        vector<Vec3b> c1, c2;
+        vector<float> g1, g2;
+        for(int y=b*h/bands; y<(b+1)*h/bands; y++)
+            for(int k=0; k<I.runs(y); k++){
+                const RunMask::Run& r = I.run(y,k);
+                int n = r.x1-r.x0;
+                c1.resize(n); c2.resize(n); g1.resize(n); g2.resize(n);
+                for(int x=r.x0; x<r.x1; x++){
+                    c1[x-r.x0] = S1.color(x,y);
+                    c2[x-r.x0] = S2.color(x,y);
+                    g1[x-r.x0] = S1.gradient(x,y);
+                    g2[x-r.x0] = S2.gradient(x,y);
+                }
+                seamCostRow(&c1[0], &c2[0], &g1[0], &g2[0], wc, wg, &O.cost[I.runRank(y,k)], n);
+            }
+    });
+
+    vector<uchar> labels;
+    double flow;
+    switch(params.capacity){
+    case CAPACITY_FLOAT:
+        flow = solveMaskMontage<float,float,float>(O, params, labels);
+        break;
+    case CAPACITY_INT:
+        flow = solveMaskMontage<int,int,int>(O, params, labels);
+        break;
+    case CAPACITY_SHORT:
+        flow = solveMaskMontage<short,int,int>(O, params, labels);
+        break;
+    default:
+        flow = solveMaskMontage<double,double,double>(O, params, labels);
+    }
+
+    RunMask U = M1|M2, from_first = only1|O.first;
+    Rect box = U.boundingRect();
+    origin = box.tl();
+    montage = Image<Vec3b>(box.width, box.height, DataType<Vec3b>::type);
+    cut = Image<float>(box.width, box.height, DataType<float>::type);
+    montage.setTo(Scalar(0,0,0));
+    cut.setTo(0);
+    for(int y=0; y<U.height(); y++)
+        for(int k=0; k<U.runs(y); k++)
+            for(int x=U.run(y,k).x0; x<U.run(y,k).x1; x++){
+                int u = O.free.index(x,y);
+                bool first = (u>=0) ? labels[u]!=0 : from_first.contains(x,y);
+                montage(x-origin.x, y-origin.y) = first ? S1.color(x,y) : S2.color(x,y);
+                cut(x-origin.x, y-origin.y) = first ? 1 : 0;
+            }
+    return flow;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "photomontage.h"
+#include "runMask.h"
+
+// An image seen through the points of the canvas it covers: the overlap of two sources is the intersection of their
+// masks, whatever their shape, instead of the rectangles of rectangleOverlap.
+class CanvasSource {
+public:
+    virtual ~CanvasSource() {}
+    // points of the canvas covered by the source
+    virtual const RunMask& mask() const = 0;
+    // color and gradient (as computeGradient) of the source at a point of mask()
+    virtual Vec3b color(int x, int y) const = 0;
+    virtual float gradient(int x, int y) const = 0;
+};
+
+// image placed at offset on a canvas of the given size, the part outside the canvas is dropped
+class TranslatedSource : public CanvasSource {
+public:
+    TranslatedSource(const Image<Vec3b>& image, Point offset, Size canvas, bool blur_image, GradientCache* cache = NULL);
+    const RunMask& mask() const { return M; }
+    Vec3b color(int x, int y) const { return image(x-offset.x, y-offset.y); }
+    float gradient(int x, int y) const { return G(x-offset.x, y-offset.y); }
+private:
+    Image<Vec3b> image;
+    Image<float> G;
+    Point offset;
+    RunMask M;
+};
+
+// Image warped onto the canvas by the homography H (from the points of the image to the points of the canvas).
+// Nothing is warped in advance: color() and gradient() map the point back to the image and interpolate bilinearly,
+// so only the points the montage asks for are sampled and the memory is the one of the image and its gradient.
+// The gradient is the one of the image, interpolated, not the gradient of the warped image. The mask is the projection
+// of the image, which must lie on one side of the line that H sends to infinity.
+class HomographySource : public CanvasSource {
+public:
+    HomographySource(const Image<Vec3b>& image, const Matx33d& H, Size canvas, bool blur_image, GradientCache* cache = NULL);
+    const RunMask& mask() const { return M; }
+    Vec3b color(int x, int y) const;
+    float gradient(int x, int y) const;
+    // projection of the point (x,y) of the image on the canvas
+    static Point2d project(const Matx33d& H, double x, double y);
+private:
+    Image<Vec3b> image;
+    Image<float> G;
+    Matx33d H_inv;
+    RunMask M;
+    // point of the image seen at (x,y), clamped to the image
+    Point2d source(int x, int y) const;
+};
+
+// Montage of two sources over the intersection of their masks.
+// The points of the intersection closer than params.delta to a point covered by one source only are fixed to that
+// source (left free when they are close to both), and the graph has a node for each free point, numbered by its rank in
+// the mask: there is no node outside the intersection, however little of its bounding box it covers. The edge weights
+// are the ones of computeSeamCosts, with the same lambda blend.
+// montage and cut cover the bounding box of the union of the masks, whose top left corner on the canvas is origin;
+// the points covered by neither source are black in montage and 0 in cut.
+// params.type, params.pyramid_levels and params.blend are not used; SOLVER_GRID falls back to SOLVER_BK.
+// Returns the value of the cut, or -1 if the sources do not overlap.
+double maskPhotomontage(const CanvasSource& S1, const CanvasSource& S2, Image<Vec3b>& montage, Image<float>& cut, Point& origin, const MontageParams& params = MontageParams());
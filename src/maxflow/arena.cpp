@@ -0,0 +1,166 @@
+/* arena.cpp */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+
+GraphArena::GraphArena(bool _huge_pages)
+	: huge_pages(_huge_pages), reserved(0), free_bytes(0), peak(0), uses(0)
+{
+}
+
+GraphArena::~GraphArena()
+{
+	trim();
+}
+
+size_t GraphArena::class_size(size_t bytes)
+{
+	if (bytes <= 64) return 64;
+	// 4 classes between two powers of two
+	size_t p = 64;
+	while (p < bytes / 2) p *= 2;
+	size_t step = p / 4;
+	return ((bytes + step - 1) / step) * step;
+}
+
+void *GraphArena::system_allocate(size_t bytes)
+{
+#ifdef __linux__
+	if (huge_pages && bytes >= HUGE_PAGE_SIZE)
+	{
+		size_t length = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+		void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p == MAP_FAILED)
+		{
+			p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+			madvise(p, length, MADV_HUGEPAGE);
+#endif
+		}
+		mapped.insert(p);
+		return p;
+	}
+#endif
+	return malloc(bytes);
+}
+
+void GraphArena::system_free(void *p, size_t bytes)
+{
+#ifdef __linux__
+	std::set<void*>::iterator it = mapped.find(p);
+	if (it != mapped.end())
+	{
+		mapped.erase(it);
+		munmap(p, (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+		return;
+	}
+#endif
+	free(p);
+}
+
+void GraphArena::release_for(size_t size)
+{
+	size_t bound = (peak > reserved - free_bytes + size) ? peak : reserved - free_bytes + size;
+	while (reserved + size > bound && free_bytes > 0)
+	{
+		std::map<size_t, SizeClass>::iterator it, oldest = classes.end();
+		for (it=classes.begin(); it!=classes.end(); it++)
+			if (!it->second.free_blocks.empty() && (oldest == classes.end() || it->second.last_use < oldest->second.last_use))
+				oldest = it;
+		SizeClass& c = oldest->second;
+		system_free(c.free_blocks.back(), oldest->first);
+		c.free_blocks.pop_back();
+		c.blocks--;
+		reserved -= oldest->first;
+		free_bytes -= oldest->first;
+	}
+}
+
+void *GraphArena::allocate(size_t bytes)
+{
+	size_t size = class_size(bytes);
+	std::lock_guard<std::mutex> lock(mutex);
+	SizeClass& c = classes[size];
+	c.last_use = ++uses;
+	void *p;
+	if (!c.free_blocks.empty())
+	{
+		p = c.free_blocks.back();
+		c.free_blocks.pop_back();
+		free_bytes -= size;
+	}
+	else
+	{
+		release_for(size);
+		// room in the list for every block of the class, so that deallocate() never allocates
+		if (c.free_blocks.capacity() < c.blocks + 1)
+			c.free_blocks.reserve(2 * (c.blocks + 1));
+		p = system_allocate(size);
+		if (!p) return NULL;
+		c.blocks++;
+		reserved += size;
+	}
+	if (reserved - free_bytes > peak) peak = reserved - free_bytes;
+	return p;
+}
+
+void *GraphArena::reallocate(void *p, size_t old_bytes, size_t bytes)
+{
+	if (!p) return allocate(bytes);
+	if (class_size(old_bytes) == class_size(bytes)) return p;
+	void *q = allocate(bytes);
+	if (!q) return NULL;
+	memcpy(q, p, (old_bytes < bytes) ? old_bytes : bytes);
+	deallocate(p, old_bytes);
+	return q;
+}
+
+void GraphArena::deallocate(void *p, size_t bytes)
+{
+	if (!p) return;
+	size_t size = class_size(bytes);
+	std::lock_guard<std::mutex> lock(mutex);
+	SizeClass& c = classes[size];
+	c.last_use = ++uses;
+	c.free_blocks.push_back(p);
+	free_bytes += size;
+}
+
+void GraphArena::trim()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<size_t, SizeClass>::iterator it;
+	for (it=classes.begin(); it!=classes.end(); it++)
+	{
+		SizeClass& c = it->second;
+		for (size_t k=0; k<c.free_blocks.size(); k++)
+		{
+			system_free(c.free_blocks[k], it->first);
+			reserved -= it->first;
+		}
+		c.blocks -= c.free_blocks.size();
+		c.free_blocks.clear();
+	}
+	free_bytes = 0;
+	peak = reserved;
+}
+
+void GraphArena::set_huge_pages(bool on)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	huge_pages = on;
+}
+
+size_t GraphArena::get_reserved()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return reserved;
+}
@@ -0,0 +1,103 @@
+/* arena.h */
+/*
+	Memory of the nodes, arcs and orphan blocks of Graph, kept from one graph to the next.
+
+	Graph allocates its arrays when it is built and grows them by 50%,
+	and maxflow() allocates blocks for the list of orphans. With an arena
+	passed to the constructor of Graph (and to DBlock), these allocations
+	are taken from free lists of size classes, and freed memory goes back
+	to the lists instead of to the system: graphs of similar sizes solved
+	one after the other reuse the same memory.
+
+	Size classes are spaced by a quarter of a power of two, so at most 25%
+	of a block is lost. An arena can be shared by several threads (each
+	call locks a mutex). The memory is given back to the system by trim()
+	or when the arena is destroyed, which must happen after all the graphs
+	using it are deleted.
+
+	The free blocks are kept as long as the reserved bytes do not exceed the
+	peak of the bytes in use. Before a block is taken from the system past
+	that bound, the free blocks of the size classes used least recently are
+	given back, so the blocks left behind by a graph growing through several
+	classes do not stay reserved next to the ones in use.
+
+	With huge pages, blocks of at least HUGE_PAGE_SIZE bytes are mapped
+	with huge pages (MAP_HUGETLB on Linux, which needs pages reserved in
+	/proc/sys/vm/nr_hugepages; otherwise the mapping is marked with
+	madvise(MADV_HUGEPAGE) for transparent huge pages). Elsewhere huge
+	pages are ignored.
+
+	Example usage:
+
+		GraphArena arena(true);
+		for (...)
+		{
+			Graph<int,int,int> g(node_num, edge_num, NULL, &arena);
+			...
+		}
+*/
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+
+class GraphArena
+{
+public:
+	static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+	GraphArena(bool huge_pages = false);
+	~GraphArena();
+
+	GraphArena(const GraphArena&) = delete;
+	GraphArena& operator=(const GraphArena&) = delete;
+
+	/* Allocates bytes, returns NULL if there is not enough memory */
+	void *allocate(size_t bytes);
+	/* Same as realloc for a block of old_bytes allocated by this arena */
+	void *reallocate(void *p, size_t old_bytes, size_t bytes);
+	/* Gives back a block of bytes allocated by this arena */
+	void deallocate(void *p, size_t bytes);
+
+	/* Frees the blocks that are not in use */
+	void trim();
+
+	/* Huge pages for the next blocks mapped from the system */
+	void set_huge_pages(bool on);
+
+	/* Bytes taken from the system, in use or not */
+	size_t get_reserved();
+
+/***********************************************************************/
+
+private:
+
+	struct SizeClass
+	{
+		std::vector<void*>	free_blocks;	// room for all the blocks of the class
+		size_t				blocks;			// blocks of the class taken from the system
+		unsigned long		last_use;		// value of uses when a block of the class was last allocated or freed
+	};
+
+	static size_t class_size(size_t bytes);
+	void *system_allocate(size_t bytes);
+	void system_free(void *p, size_t bytes);
+	/* Gives back free blocks of the classes used least recently until size more bytes fit below the peak */
+	void release_for(size_t size);
+
+	std::mutex							mutex;
+	bool								huge_pages;
+	std::map<size_t, SizeClass>			classes;	// by class size
+	std::set<void*>						mapped;		// blocks mapped with mmap instead of malloc
+	size_t								reserved;	// bytes taken from the system
+	size_t								free_bytes;	// bytes of the free blocks
+	size_t								peak;		// largest number of bytes in use
+	unsigned long						uses;
+};
+
+#endif
@@ -90,6 +90,8 @@
 #ifndef __BLOCK_H__
 #define __BLOCK_H__
 
+#include "arena.h"
+
 #include <stdlib.h>
 
 /***********************************************************************/
@@ -202,14 +204,24 @@ private:
 template <class Type> class DBlock
 {
 public:
-	/* Constructor. Arguments are the block size and
+	/* Constructor. Arguments are the block size,
 	   (optionally) the pointer to the function which
 	   will be called if allocation failed; the message
-	   passed to this function is "Not enough memory!" */
-	DBlock(int size, void (*err_function)(char *) = NULL) { first = NULL; first_free = NULL; block_size = size; error_function = err_function; }
+	   passed to this function is "Not enough memory!",
+	   and (optionally) the arena the blocks are taken from */
+	DBlock(int size, void (*err_function)(char *) = NULL, GraphArena *_arena = NULL) { first = NULL; first_free = NULL; block_size = size; error_function = err_function; arena = _arena; }
 
 	/* Destructor. Deallocates all items added so far */
-	~DBlock() { while (first) { block *next = first -> next; delete first; first = next; } }
+	~DBlock()
+	{
+		while (first)
+		{
+			block *next = first -> next;
+			if (arena) arena -> deallocate(first, block_bytes());
+			else delete [] (char *) first;
+			first = next;
+		}
+	}
 
 	/* Allocates one item */
 	Type *New()
@@ -219,7 +231,7 @@ public:
 		if (!first_free)
 		{
 			block *next = first;
-			first = (block *) new char [sizeof(block) + (block_size-1)*sizeof(block_item)];
+			first = (block *) (arena ? arena -> allocate(block_bytes()) : new char [block_bytes()]);
 			if (!first) { if (error_function) (*error_function)((char*)"Not enough memory!"); exit(1); }
 			first_free = & (first -> data[0] );
 			for (item=first_free; item<first_free+block_size-1; item++)
@@ -259,6 +271,9 @@ private:
 	int			block_size;
 	block		*first;
 	block_item	*first_free;
+	GraphArena	*arena;
+
+	size_t block_bytes() { return sizeof(block) + (block_size-1)*sizeof(block_item); }
 
 	void	(*error_function)(char *);
 };
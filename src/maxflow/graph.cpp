@@ -8,16 +8,17 @@
 
 
 template <typename captype, typename tcaptype, typename flowtype> 
-	Graph<captype, tcaptype, flowtype>::Graph(int node_num_max, int edge_num_max, void (*err_function)(char *))
+	Graph<captype, tcaptype, flowtype>::Graph(int node_num_max, int edge_num_max, void (*err_function)(char *), GraphArena *_arena)
 	: node_num(0),
 	  nodeptr_block(NULL),
+	  arena(_arena),
 	  error_function(err_function)
 {
 	if (node_num_max < 16) node_num_max = 16;
 	if (edge_num_max < 16) edge_num_max = 16;
 
-	nodes = (node*) malloc(node_num_max*sizeof(node));
-	arcs = (arc*) malloc(2*edge_num_max*sizeof(arc));
+	nodes = (node*) mem_allocate(node_num_max*sizeof(node));
+	arcs = (arc*) mem_allocate(2*edge_num_max*sizeof(arc));
 	if (!nodes || !arcs) { if (error_function) (*error_function)((char*)"Not enough memory!"); exit(1); }
 
 	node_last = nodes;
@@ -37,8 +38,8 @@ template <typename captype, typename tcaptype, typename flowtype>
 		delete nodeptr_block; 
 		nodeptr_block = NULL; 
 	}
-	free(nodes);
-	free(arcs);
+	mem_free(nodes, (node_max - nodes)*sizeof(node));
+	mem_free(arcs, (arc_max - arcs)*sizeof(arc));
 }
 
 template <typename captype, typename tcaptype, typename flowtype> 
@@ -58,6 +59,76 @@ template <typename captype, typename tcaptype, typename flowtype>
 	flow = 0;
 }
 
+template <typename captype, typename tcaptype, typename flowtype> 
+	void *Graph<captype,tcaptype,flowtype>::mem_allocate(size_t bytes)
+{
+	return arena ? arena->allocate(bytes) : malloc(bytes);
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	void *Graph<captype,tcaptype,flowtype>::mem_reallocate(void *p, size_t old_bytes, size_t bytes)
+{
+	return arena ? arena->reallocate(p, old_bytes, bytes) : realloc(p, bytes);
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	void Graph<captype,tcaptype,flowtype>::mem_free(void *p, size_t bytes)
+{
+	if (arena) arena->deallocate(p, bytes);
+	else free(p);
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	void Graph<captype,tcaptype,flowtype>::take(Graph& g)
+{
+	nodes = g.nodes; node_last = g.node_last; node_max = g.node_max;
+	arcs = g.arcs; arc_last = g.arc_last; arc_max = g.arc_max;
+	node_num = g.node_num;
+	nodeptr_block = g.nodeptr_block;
+	arena = g.arena;
+	error_function = g.error_function;
+	flow = g.flow;
+	maxflow_iteration = g.maxflow_iteration;
+	changed_list = g.changed_list;
+	queue_first[0] = g.queue_first[0]; queue_first[1] = g.queue_first[1];
+	queue_last[0] = g.queue_last[0]; queue_last[1] = g.queue_last[1];
+	orphan_first = g.orphan_first; orphan_last = g.orphan_last;
+	TIME = g.TIME;
+
+	g.nodes = g.node_last = g.node_max = NULL;
+	g.arcs = g.arc_last = g.arc_max = NULL;
+	g.node_num = 0;
+	g.nodeptr_block = NULL;
+	g.maxflow_iteration = 0;
+	g.flow = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	Graph<captype,tcaptype,flowtype>::Graph(Graph&& g)
+{
+	take(g);
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	Graph<captype,tcaptype,flowtype>& Graph<captype,tcaptype,flowtype>::operator=(Graph&& g)
+{
+	if (this != &g)
+	{
+		if (nodeptr_block) delete nodeptr_block;
+		mem_free(nodes, (node_max - nodes)*sizeof(node));
+		mem_free(arcs, (arc_max - arcs)*sizeof(arc));
+		take(g);
+	}
+	return *this;
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	void Graph<captype,tcaptype,flowtype>::reserve(int node_num_max, int edge_num_max)
+{
+	if (node_max - nodes < node_num_max) reallocate_nodes(node_num_max - node_num);
+	while (arc_max - arcs < 2*edge_num_max) reallocate_arcs();
+}
+
 template <typename captype, typename tcaptype, typename flowtype> 
 	void Graph<captype,tcaptype,flowtype>::reallocate_nodes(int num)
 {
@@ -66,7 +137,7 @@ template <typename captype, typename tcaptype, typename flowtype>
 
 	node_num_max += node_num_max / 2;
 	if (node_num_max < node_num + num) node_num_max = node_num + num;
-	nodes = (node*) realloc(nodes_old, node_num_max*sizeof(node));
+	nodes = (node*) mem_reallocate(nodes_old, (node_max - nodes_old)*sizeof(node), node_num_max*sizeof(node));
 	if (!nodes) { if (error_function) (*error_function)((char*)"Not enough memory!"); exit(1); }
 
 	node_last = nodes + node_num;
@@ -90,7 +161,7 @@ template <typename captype, typename tcaptype, typename flowtype>
 	arc* arcs_old = arcs;
 
 	arc_num_max += arc_num_max / 2; if (arc_num_max & 1) arc_num_max ++;
-	arcs = (arc*) realloc(arcs_old, arc_num_max*sizeof(arc));
+	arcs = (arc*) mem_reallocate(arcs_old, (arc_max - arcs_old)*sizeof(arc), arc_num_max*sizeof(arc));
 	if (!arcs) { if (error_function) (*error_function)((char*)"Not enough memory!"); exit(1); }
 
 	arc_last = arcs + arc_num;
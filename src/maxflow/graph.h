@@ -41,6 +41,7 @@
 
 #include <string.h>
 #include "block.h"
+#include "arena.h"
 
 #include <assert.h>
 // NOTE: in UNIX you need to use -DNDEBUG preprocessor option to supress assert's!!!
@@ -80,11 +81,20 @@ public:
 	// Also, temporarily the amount of allocated memory would be more than twice than needed.
 	// Similarly for edges.
 	// If you wish to avoid this overhead, you can download version 2.2, where nodes and edges are stored in blocks.
-	Graph(int node_num_max, int edge_num_max, void (*err_function)(char *) = NULL);
+	// If arena is not NULL, the nodes, arcs and orphan blocks are allocated from it (see arena.h);
+	// it must outlive the graph.
+	Graph(int node_num_max, int edge_num_max, void (*err_function)(char *) = NULL, GraphArena *arena = NULL);
 
 	// Destructor
 	~Graph();
 
+	// A graph owns the memory of its nodes and arcs: it can be moved (the moved-from graph
+	// can then only be destroyed or assigned to), not copied.
+	Graph(Graph&& g);
+	Graph& operator=(Graph&& g);
+	Graph(const Graph&) = delete;
+	Graph& operator=(const Graph&) = delete;
+
 	// Adds node(s) to the graph. By default, one node is added (num=1); then first call returns 0, second call returns 1, and so on. 
 	// If num>1, then several nodes are added, and node_id of the first one is returned.
 	// IMPORTANT: see note about the constructor 
@@ -142,6 +152,11 @@ public:
 	// (see functions below).
 	void reset();
 
+	// Makes room for node_num_max nodes and edge_num_max edges in total, so that adding
+	// them does not reallocate the internal memory. Used with reset() to reuse a graph
+	// for a graph of another size.
+	void reserve(int node_num_max, int edge_num_max);
+
 	////////////////////////////////////////////////////////////////////////////////
 	// 2. Functions for getting pointers to arcs and for reading graph structure. //
 	//    NOTE: adding new arcs may invalidate these pointers (if reallocation    //
@@ -247,6 +262,33 @@ public:
 		nodes[i].is_in_changed_list = 0;
 	}
 
+	///////////////////////////////////////////////////////
+	// 6. Functions for building the graph from threads. //
+	///////////////////////////////////////////////////////
+
+	// reserve_edges(num) adds num edges at once and returns the index of the first one;
+	// edge e has the arcs 2e (i->j) and 2e+1 (j->i) counting from get_first_arc().
+	// Each reserved edge must then get its ends and capacities with set_edge(),
+	// and its arcs must be added to the lists of the arcs of their origin with link_edge(),
+	// before maxflow() is called.
+	//
+	// set_edge() only writes the two arcs of the edge, so several threads can set different edges
+	// at the same time. link_edge() writes the node of each arc it links and set_tweights() writes its node,
+	// so the threads must share the nodes out: a thread links the arc i->j only if it owns i,
+	// and the arcs left over are linked afterwards by a single thread.
+	//
+	// set_tweights(i,cap_source,cap_sink) is add_tweights() for a node without t-links yet,
+	// except that the flow it adds to the cut, min(cap_source,cap_sink), is returned instead of added;
+	// it must then be passed to add_flow() by a single thread.
+	//
+	// NOTE: the order of the arcs in the lists of a node depends on the order of the calls to link_edge(),
+	// which may change which one of several minimum cuts is found, not the value of the flow.
+	int reserve_edges(int num);
+	void set_edge(int e, node_id i, node_id j, captype cap, captype rev_cap);
+	void link_edge(int e, bool link_i = true, bool link_j = true);
+	tcaptype set_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink);
+	void add_flow(flowtype f) { flow += f; }
+
 
 
 
@@ -300,6 +342,8 @@ private:
 
 	DBlock<nodeptr>		*nodeptr_block;
 
+	GraphArena			*arena;		// allocator of nodes, arcs and nodeptr_block, malloc if NULL
+
 	void	(*error_function)(char *);	// this function is called if a error occurs,
 										// with a corresponding error message
 										// (or exit(1) is called if it's NULL)
@@ -318,6 +362,10 @@ private:
 
 	/////////////////////////////////////////////////////////////////////////
 
+	void *mem_allocate(size_t bytes);
+	void *mem_reallocate(void *p, size_t old_bytes, size_t bytes);
+	void mem_free(void *p, size_t bytes);
+	void take(Graph& g); // takes the memory and the state of g, which is left empty
 	void reallocate_nodes(int num); // num is the number of new nodes
 	void reallocate_arcs();
 
@@ -425,6 +473,72 @@ template <typename captype, typename tcaptype, typename flowtype>
 	a_rev -> r_cap = rev_cap;
 }
 
+template <typename captype, typename tcaptype, typename flowtype> 
+	inline int Graph<captype,tcaptype,flowtype>::reserve_edges(int num)
+{
+	assert(num >= 0);
+
+	while (arc_last + 2*num > arc_max) reallocate_arcs();
+
+	int e = (int)(arc_last - arcs) / 2;
+	arc_last += 2*num;
+	return e;
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	inline void Graph<captype,tcaptype,flowtype>::set_edge(int e, node_id _i, node_id _j, captype cap, captype rev_cap)
+{
+	assert(e >= 0 && arcs + 2*e + 1 < arc_last);
+	assert(_i >= 0 && _i < node_num);
+	assert(_j >= 0 && _j < node_num);
+	assert(_i != _j);
+	assert(cap >= 0);
+	assert(rev_cap >= 0);
+
+	arc *a = arcs + 2*e;
+	arc *a_rev = a + 1;
+
+	a -> sister = a_rev;
+	a_rev -> sister = a;
+	a -> next = NULL;
+	a_rev -> next = NULL;
+	a -> head = nodes + _j;
+	a_rev -> head = nodes + _i;
+	a -> r_cap = cap;
+	a_rev -> r_cap = rev_cap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	inline void Graph<captype,tcaptype,flowtype>::link_edge(int e, bool link_i, bool link_j)
+{
+	assert(e >= 0 && arcs + 2*e + 1 < arc_last);
+
+	arc *a = arcs + 2*e;
+	arc *a_rev = a + 1;
+
+	if (link_i)
+	{
+		node* i = a_rev -> head;
+		a -> next = i -> first;
+		i -> first = a;
+	}
+	if (link_j)
+	{
+		node* j = a -> head;
+		a_rev -> next = j -> first;
+		j -> first = a_rev;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	inline tcaptype Graph<captype,tcaptype,flowtype>::set_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink)
+{
+	assert(i >= 0 && i < node_num);
+
+	nodes[i].tr_cap = cap_source - cap_sink;
+	return (cap_source < cap_sink) ? cap_source : cap_sink;
+}
+
 template <typename captype, typename tcaptype, typename flowtype> 
 	inline typename Graph<captype,tcaptype,flowtype>::arc* Graph<captype,tcaptype,flowtype>::get_first_arc()
 {
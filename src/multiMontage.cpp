@@ -0,0 +1,213 @@
+#include "multiMontage.h"
+#include "graphPool.h"
+
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+
+// The sources and their gradients on the canvas, and the seam cost between two of them.
+// The cost of a seam between the labels a and b at the neighbouring points p and q is D(a,b,p) + D(a,b,q), where D is
+// the blended BGR and gradient distance of the two sources at a point, counted only where both sources cover it.
+// A seam along the border of a source is thus only charged on its inner side, as the border of the overlap is in
+// the two-image montage.
+namespace {
+struct MultiCanvas {
+    const vector<MontageSource>& sources;
+    vector<Image<float> > gradients;
+    vector<Rect> rects; // place of each source on the canvas
+    int width, height;
+    float wc, wg;
+
+    MultiCanvas(const vector<MontageSource>& sources) : sources(sources) {}
+
+    double pointCost(int x, int y, int a, int b) const {
+        Point p(x, y);
+        if(!rects[a].contains(p) || !rects[b].contains(p))
+            return 0;
+        const Vec3b& ca = sources[a].image(x-rects[a].x, y-rects[a].y);
+        const Vec3b& cb = sources[b].image(x-rects[b].x, y-rects[b].y);
+        float d0 = float(ca[0])-cb[0], d1 = float(ca[1])-cb[1], d2 = float(ca[2])-cb[2];
+        float g = gradients[a](x-rects[a].x, y-rects[a].y) - gradients[b](x-rects[b].x, y-rects[b].y);
+        return wc*sqrt(d0*d0+d1*d1+d2*d2) + wg*fabs(g);
+    }
+
+    // cost of the edge between (x1,y1) labeled a and (x2,y2) labeled b
+    double seamCost(int x1, int y1, int x2, int y2, int a, int b) const {
+        if(a==b)
+            return 0;
+        return pointCost(x1, y1, a, b) + pointCost(x2, y2, a, b);
+    }
+};
+}
+
+static const int dx[4] = {1, 0, -1, 0};
+static const int dy[4] = {0, 1, 0, -1};
+
+// total seam cost of the labeling
+static double labelingCost(const MultiCanvas& canvas, const Image<int>& labels){
+    double cost = 0;
+    for(int y=0; y<canvas.height; y++)
+        for(int x=0; x<canvas.width; x++){
+            if(labels(x,y)<0)
+                continue;
+            if(x+1<canvas.width && labels(x+1,y)>=0)
+                cost += canvas.seamCost(x, y, x+1, y, labels(x,y), labels(x+1,y));
+            if(y+1<canvas.height && labels(x,y+1)>=0)
+                cost += canvas.seamCost(x, y, x, y+1, labels(x,y), labels(x,y+1));
+        }
+    return cost;
+}
+
+// Expansion move of alpha: every point covered by alpha either keeps its label or takes alpha.
+// A node x=0 (SOURCE) keeps its label, x=1 (SINK) takes alpha. For an edge of energy E(x_p,x_q) with
+// A=E(0,0), B=E(0,1), C=E(1,0), D=E(1,1), E = A + (C-A)x_p + (D-C)x_q + (B+C-A-D)(1-x_p)x_q (Kolmogorov and Zabih):
+// two t-links and an arc p->q of capacity B+C-A-D, which must not be negative. The seam cost is not a metric where
+// sources do not cover both points, so A is truncated to B+C when needed, and the move is only kept if it lowers
+// the true cost.
+// Returns the change of the cost (0 if the move was not kept).
+static double expansionMove(const MultiCanvas& canvas, Image<int>& labels, int alpha){
+    Rect r = canvas.rects[alpha];
+    Image<int> nodes(r.width, r.height, CV_32S);
+    int node_num = 0;
+    for(int y=0; y<r.height; y++)
+        for(int x=0; x<r.width; x++)
+            nodes(x,y) = labels(r.x+x, r.y+y)==alpha ? -1 : node_num++;
+    if(node_num==0)
+        return 0;
+
+    // the moves of the same source have the same size, they reuse the same graph
+    GraphPool<double,double,double>::GraphPtr P = graphPool<double,double,double>().acquire(node_num, 2*node_num);
+    Graph<double,double,double>& G = *P;
+    G.add_node(node_num);
+    // the edges of the nodes, each one from its upper or left end; the neighbours outside the rectangle are fixed
+    for(int y=-1; y<r.height; y++)
+        for(int x=-1; x<r.width; x++)
+            for(int k=0; k<2; k++){
+                int x2 = x+dx[k], y2 = y+dy[k];
+                int cx = r.x+x, cy = r.y+y, cx2 = r.x+x2, cy2 = r.y+y2;
+                if(cx<0 || cy<0 || cx2>=canvas.width || cy2>=canvas.height)
+                    continue;
+                int lp = labels(cx,cy), lq = labels(cx2,cy2);
+                if(lp<0 || lq<0)
+                    continue;
+                int p = (x>=0 && y>=0) ? nodes(x,y) : -1;
+                int q = (x2>=0 && y2>=0 && x2<r.width && y2<r.height) ? nodes(x2,y2) : -1;
+                if(p<0 && q<0)
+                    continue;
+                double A = canvas.seamCost(cx, cy, cx2, cy2, lp, lq);
+                if(p>=0 && q>=0){
+                    double B = canvas.seamCost(cx, cy, cx2, cy2, lp, alpha);
+                    double C = canvas.seamCost(cx, cy, cx2, cy2, alpha, lq);
+                    A = min(A, B+C);
+                    if(C>A) G.add_tweights(p, C-A, 0);
+                    else G.add_tweights(p, 0, A-C);
+                    G.add_tweights(q, 0, C); // D-C with D=0
+                    G.add_edge(p, q, B+C-A, 0);
+                }
+                else if(p>=0)
+                    G.add_tweights(p, canvas.seamCost(cx, cy, cx2, cy2, alpha, lq), A);
+                else
+                    G.add_tweights(q, canvas.seamCost(cx, cy, cx2, cy2, lp, alpha), A);
+            }
+    G.maxflow();
+
+    // change of the true cost over the edges of the points that take alpha
+    vector<Point> changed;
+    vector<int> previous;
+    for(int y=0; y<r.height; y++)
+        for(int x=0; x<r.width; x++)
+            if(nodes(x,y)>=0 && G.what_segment(nodes(x,y))==Graph<double,double,double>::SINK){
+                changed.push_back(Point(r.x+x, r.y+y));
+                previous.push_back(labels(r.x+x, r.y+y));
+            }
+    if(changed.empty())
+        return 0;
+    double gain = 0;
+    for(size_t k=0; k<changed.size(); k++){
+        int x = changed[k].x, y = changed[k].y;
+        for(int d=0; d<4; d++){
+            int x2 = x+dx[d], y2 = y+dy[d];
+            if(x2<0 || y2<0 || x2>=canvas.width || y2>=canvas.height || labels(x2,y2)<0)
+                continue;
+            int l2 = labels(x2,y2);
+            bool changed2 = r.contains(Point(x2,y2)) && nodes(x2-r.x,y2-r.y)>=0 && G.what_segment(nodes(x2-r.x,y2-r.y))==Graph<double,double,double>::SINK;
+            if(changed2){
+                // the edge between two changed points is counted once, its new cost is 0
+                if(d>=2)
+                    continue;
+                gain -= canvas.seamCost(x, y, x2, y2, previous[k], l2);
+            }
+            else
+                gain += canvas.seamCost(x, y, x2, y2, alpha, l2) - canvas.seamCost(x, y, x2, y2, previous[k], l2);
+        }
+    }
+    // rounding errors aside, a move that does not lower the cost is dropped
+    if(gain>-1e-6)
+        return 0;
+    for(size_t k=0; k<changed.size(); k++)
+        labels(changed[k].x, changed[k].y) = alpha;
+    return gain;
+}
+
+double multiPhotomontage(const vector<MontageSource>& sources, Image<Vec3b>& montage, Image<int>& labels, const MontageParams& params, int max_cycles, GradientCache* cache){
+    if(sources.empty()){
+        cout << "multiPhotomontage needs at least one image." << endl;
+        return -1;
+    }
+    int max_lambda = params.max_lambda, lambda = params.lambda;
+    if(max_lambda==0){
+        cout << "max_lambda was set to 0, but was supposed to be constant and greater than zero." << endl;
+        max_lambda = 1;
+        lambda = 0;
+    }
+
+    // the canvas is the bounding box of the sources
+    Point p1 = sources[0].offset, p2 = p1;
+    for(size_t a=0; a<sources.size(); a++){
+        p1.x = min(p1.x, sources[a].offset.x);
+        p1.y = min(p1.y, sources[a].offset.y);
+        p2.x = max(p2.x, sources[a].offset.x+sources[a].image.width());
+        p2.y = max(p2.y, sources[a].offset.y+sources[a].image.height());
+    }
+    MultiCanvas canvas(sources);
+    canvas.width = p2.x-p1.x;
+    canvas.height = p2.y-p1.y;
+    canvas.wc = float(max_lambda-lambda)/max_lambda;
+    canvas.wg = float(lambda)/max_lambda;
+    for(size_t a=0; a<sources.size(); a++){
+        const Image<Vec3b>& I = sources[a].image;
+        canvas.rects.push_back(Rect(sources[a].offset-p1, I.size()));
+        if(cache)
+            canvas.gradients.push_back(cache->gradient(I, params.blur_image));
+        else{
+            Image<float> G(I.width(), I.height(), CV_32F);
+            computeGradient(I, G, params.blur_image);
+            canvas.gradients.push_back(G);
+        }
+    }
+
+    // each point starts with the first source covering it
+    labels = Image<int>(canvas.width, canvas.height, CV_32S);
+    labels.setTo(-1);
+    for(int a=int(sources.size())-1; a>=0; a--)
+        Mat(labels, canvas.rects[a]).setTo(Scalar(a));
+
+    double cost = labelingCost(canvas, labels);
+    for(int cycle=0; cycle<max_cycles; cycle++){
+        double gain = 0;
+        for(int a=0; a<int(sources.size()); a++)
+            gain += expansionMove(canvas, labels, a);
+        cost += gain;
+        if(gain==0)
+            break;
+    }
+
+    montage = Image<Vec3b>(canvas.width, canvas.height, DataType<Vec3b>::type);
+    for(int y=0; y<canvas.height; y++)
+        for(int x=0; x<canvas.width; x++){
+            int a = labels(x,y);
+            montage(x,y) = a<0 ? Vec3b(0,0,0) : sources[a].image(x-canvas.rects[a].x, y-canvas.rects[a].y);
+        }
+    return cost;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "photomontage.h"
+
+// an image of a multi-image montage, placed at offset on the canvas
+struct MontageSource {
+    Image<Vec3b> image;
+    Point offset;
+    MontageSource() {}
+    MontageSource(const Image<Vec3b>& image, Point offset) : image(image), offset(offset) {}
+};
+
+// Montage of any number of images by alpha-expansion moves.
+// Each point of the canvas (the bounding box of all the sources) takes its color from one of the sources covering it;
+// the labels minimize the sum over neighbouring points p,q labeled a,b of the seam cost between a and b at p and q,
+// with the same lambda blend of BGR and gradient distances as the two-image montage (params.delta, params.capacity and
+// params.pyramid_levels are not used).
+// Each expansion move of a source is a Graph over the points of that source only, so a move costs in proportion to
+// the source, not to the canvas. Moves are repeated over all the sources until a cycle does not lower the cost,
+// or after max_cycles cycles.
+// montage receives the combined image, labels the index of the source of each point (-1 where no source covers it).
+// Returns the seam cost of the montage, or -1 if there is no source.
+double multiPhotomontage(const vector<MontageSource>& sources, Image<Vec3b>& montage, Image<int>& labels, const MontageParams& params = MontageParams(), int max_cycles = 3, GradientCache* cache = NULL);
@@ -0,0 +1,142 @@
+#include "offsetSearch.h"
+#include "parallel.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+using namespace std;
+
+// lines of the overlap whose seam costs are computed at once before checking the bound
+static const int strip_lines = 32;
+
+static Point firstOffset(Point d){
+    return Point(max(0, -d.x), max(0, -d.y));
+}
+
+// lowers best to value if it is smaller, from any thread
+static void lowerTo(atomic<double>& best, double value){
+    double current = best.load();
+    while(value<current && !best.compare_exchange_weak(current, value));
+}
+
+// bounds of the seam cost of the candidate, false if it overlaps too little or is pruned.
+// The lower bound needs both ends of each line fixed to different images: with delta<1 no point is fixed, the best
+// cut may leave the whole overlap to one image, the lower bound is 0 and nothing is pruned.
+static bool scoreCandidate(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, const Image<float>& G1, const Image<float>& G2, const MontageParams& params, int min_overlap, atomic<double>& best_upper, OffsetCandidate& c){
+    bool right_order1=true, right_order2=true;
+    Rectangle rec, overlap;
+    if(!selectRectangles(rectangleOverlap(I1color.size(), I2color.size(), c.offset1, c.offset2, right_order1, right_order2), rec, overlap, params.type))
+        return false;
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    // the seam crosses the lines (rows for type 1), going from one end of a line (of across points) to the other
+    int lines = (params.type==1) ? h : w, across = (params.type==1) ? w : h;
+    if(lines<min_overlap || across<=2*params.delta)
+        return false;
+
+    // straight seams between the bands fixed by delta: after the point k of each line, k in [delta-1, across-delta]
+    int k0 = max(params.delta-1, 0), k1 = min(across-params.delta, across-2);
+    bool pinned = params.delta>=1;
+    vector<double> straight(across-1, 0);
+    double lower = 0;
+    for(int s0=0; s0<lines; s0+=strip_lines){
+        int s1 = min(s0+strip_lines, lines);
+        Rectangle strip = overlap;
+        if(params.type==1){
+            strip.p1.y = overlap.p1.y+s0;
+            strip.p2.y = overlap.p1.y+s1;
+        }
+        else{
+            strip.p1.x = overlap.p1.x+s0;
+            strip.p2.x = overlap.p1.x+s1;
+        }
+        Image<float> horizontal, vertical;
+        computeSeamCosts(strip, I1color, I2color, G1, G2, c.offset1, c.offset2, params.lambda, params.max_lambda, horizontal, vertical);
+        // the edges crossing the lines: horizontal ones for type 1, vertical ones for type 2
+        Mat cross = (params.type==1) ? Mat(horizontal) : Mat(vertical.t());
+        for(int l=0; l<s1-s0; l++){
+            const float* e = cross.ptr<float>(l);
+            if(pinned)
+                lower += *min_element(e, e+across-1);
+            for(int k=0; k<across-1; k++)
+                straight[k] += e[k];
+        }
+        if(pinned && lower/lines>best_upper.load())
+            return false;
+    }
+    c.length = lines;
+    c.lower_bound = lower/lines;
+    c.upper_bound = numeric_limits<double>::max();
+    for(int k=k0; k<=k1; k++)
+        c.upper_bound = min(c.upper_bound, straight[k]/lines);
+    lowerTo(best_upper, c.upper_bound);
+    return true;
+}
+
+vector<OffsetCandidate> searchOffsets(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point d_min, Point d_max, int step, Image<Vec3b>& montage, Image<float>& cut, const MontageParams& params, int top_k, int min_overlap){
+    step = max(step, 1);
+    // the bounds are those of the overlap rectangle, the candidates are solved on it too
+    MontageParams rectangle_params = params;
+    rectangle_params.overlap = OVERLAP_RECTANGLE;
+    vector<OffsetCandidate> candidates;
+    for(int dy=d_min.y; dy<=d_max.y; dy+=step)
+        for(int dx=d_min.x; dx<=d_max.x; dx+=step){
+            OffsetCandidate c;
+            c.offset1 = firstOffset(Point(dx, dy));
+            c.offset2 = c.offset1+Point(dx, dy);
+            c.cost = -1;
+            candidates.push_back(c);
+        }
+    // the gradients do not depend on the offsets
+    Image<float> G1(I1color.width(), I1color.height(), CV_32F), G2(I2color.width(), I2color.height(), CV_32F);
+    computeGradient(I1color, G1, params.blur_image);
+    computeGradient(I2color, G2, params.blur_image);
+
+    atomic<double> best_upper(numeric_limits<double>::max());
+    vector<char> kept(candidates.size(), 0);
+    parallelFor((int)candidates.size(), [&](int k) {
+        kept[k] = scoreCandidate(I1color, I2color, G1, G2, rectangle_params, min_overlap, best_upper, candidates[k]);
+    });
+    // a candidate scored before the best upper bound was found may still be above it
+    vector<OffsetCandidate> remaining;
+    for(size_t k=0; k<candidates.size(); k++)
+        if(kept[k] && candidates[k].lower_bound<=best_upper.load())
+            remaining.push_back(candidates[k]);
+    cout << candidates.size() << " candidate offsets, " << remaining.size() << " left after pruning" << endl;
+    if(remaining.empty())
+        return remaining;
+    sort(remaining.begin(), remaining.end(), [](const OffsetCandidate& a, const OffsetCandidate& b) {
+        if(a.lower_bound!=b.lower_bound)
+            return a.lower_bound<b.lower_bound;
+        return a.upper_bound<b.upper_bound;
+    });
+    if((int)remaining.size()>top_k)
+        remaining.resize(max(top_k, 1));
+
+    int n = (int)remaining.size();
+    vector<Image<Vec3b> > montages(n);
+    vector<Image<float> > cuts(n);
+    // one after the other: photomontage already builds and solves each graph on all the threads
+    for(int k=0; k<n; k++){
+        OffsetCandidate& c = remaining[k];
+        double flow = photomontage(I1color, I2color, c.offset1, c.offset2, montages[k], cuts[k], rectangle_params);
+        if(flow>=0)
+            c.cost = flow/c.length;
+    }
+    int best = -1;
+    for(int k=0; k<n; k++)
+        if(remaining[k].cost>=0 && (best<0 || remaining[k].cost<remaining[best].cost))
+            best = k;
+    if(best>=0){
+        montage = montages[best];
+        cut = cuts[best];
+    }
+    // solved candidates first, by cost
+    sort(remaining.begin(), remaining.end(), [](const OffsetCandidate& a, const OffsetCandidate& b) {
+        if((a.cost<0)!=(b.cost<0))
+            return b.cost<0;
+        return a.cost<b.cost;
+    });
+    return remaining;
+}
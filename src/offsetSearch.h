@@ -0,0 +1,25 @@
+#pragma once
+
+#include "photomontage.h"
+
+// a pair of offsets evaluated by searchOffsets, the costs divided by the length of the seam (the number of rows of
+// the overlap for type 1, of columns for type 2) so that overlaps of different sizes compare
+struct OffsetCandidate {
+    Point offset1, offset2;
+    int length;         // length of the seam
+    double lower_bound; // each row (type 1) or column (type 2) of the overlap is cut at least once by the seam
+    double upper_bound; // best straight seam, larger than the lower bound of the candidates that are pruned
+    double cost;        // seam cost of the montage, -1 if it was not solved
+};
+
+// Montage of two images whose translation is not known: the translations d = offset2-offset1 of the grid
+// d_min + step*(i,j) up to d_max are scored by bounds of their seam cost over the overlap given by rectangleOverlap.
+// The overlaps must be at least min_overlap points long along the seam and leave free points between the bands of
+// params.delta. The seam costs of a candidate are computed by strips along the seam, and the candidate is dropped as
+// soon as its lower bound exceeds the best upper bound found so far (only when params.delta>=1, otherwise the seam may
+// not cross the overlap and nothing is pruned). The top_k remaining candidates with the lowest lower bounds are solved
+// by photomontage. Candidates are scored in parallel, then solved one after the other, each on all the threads.
+// params.overlap is not used: the overlap is always the rectangle of params.type.
+// montage and cut receive the best montage. Returns the top_k candidates, best first and those that could not be
+// solved (cost -1) last; empty if no candidate overlaps enough.
+vector<OffsetCandidate> searchOffsets(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point d_min, Point d_max, int step, Image<Vec3b>& montage, Image<float>& cut, const MontageParams& params = MontageParams(), int top_k = 4, int min_overlap = 32);
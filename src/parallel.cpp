@@ -0,0 +1,13 @@
+#include "parallel.h"
+
+static int thread_num = 0; // 0 until set, then the number of cores
+
+int parallelThreads(){
+    if(thread_num<=0)
+        thread_num = std::max(1, (int)std::thread::hardware_concurrency());
+    return thread_num;
+}
+
+void setParallelThreads(int n){
+    thread_num = std::max(1, n);
+}
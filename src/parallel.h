@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Number of threads used by parallelFor: the number of cores by default, 1 runs everything on the calling thread.
+int parallelThreads();
+void setParallelThreads(int n);
+
+// Calls f(k) for k = 0..n-1 on parallelThreads() threads, the calling thread being one of them.
+// The k are handed out in contiguous blocks, so f(k) and f(k+1) usually run on the same thread.
+// Returns when all the calls are done.
+template <typename F> void parallelFor(int n, F f){
+    int threads = std::min(parallelThreads(), n);
+    if(threads<=1){
+        for(int k=0; k<n; k++)
+            f(k);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for(int t=1; t<threads; t++)
+        workers.push_back(std::thread([=]() {
+            for(int k=t*n/threads; k<(t+1)*n/threads; k++)
+                f(k);
+        }));
+    for(int k=0; k<n/threads; k++)
+        f(k);
+    for(size_t t=0; t<workers.size(); t++)
+        workers[t].join();
+}
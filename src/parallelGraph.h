@@ -0,0 +1,88 @@
+#pragma once
+
+#include "maxflow/graph.h"
+#include "parallel.h"
+#include "graphPool.h"
+
+#include <algorithm>
+#include <vector>
+
+// Maxflow of G on several threads, same result as G.maxflow(). The graph must be fully built, its trees are not
+// reused.
+//
+// The nodes are split in parallelThreads() blocks of consecutive ids (bands of rows for the seam graph, whose points
+// are numbered row by row). Each thread solves the maxflow of one block with the edges inside it, then writes the
+// residual capacities back into the graph. The flow of the blocks is a valid flow of the whole graph, so the maxflow
+// of the residual graph, solved by Graph::maxflow() on one thread, completes it: the flow is the same as with
+// Graph::maxflow() and the cut is a minimum cut (when there are several, not always the same one).
+// The final maxflow is short when the blocks are large compared to the seam, which is the case of an overlap cut in
+// bands across the seam.
+//
+// Each block has its own Graph for the time of the parallel phase, which about doubles the memory of the graph. These
+// graphs come from graphPool() and are reused by the next calls.
+template <typename captype, typename tcaptype, typename flowtype>
+flowtype parallelMaxflow(Graph<captype,tcaptype,flowtype>& G){
+    typedef Graph<captype,tcaptype,flowtype> GraphType;
+    typedef typename GraphType::node_id node_id;
+    typedef typename GraphType::arc_id arc_id;
+    int node_num = G.get_node_num();
+    int blocks = std::min(parallelThreads(), node_num);
+    if(blocks<=1)
+        return G.maxflow();
+    // block b holds the nodes from begin(b) to begin(b+1) excluded
+    auto begin = [=](int b) { return (node_id)((long long)b*node_num/blocks); };
+    auto block = [=](node_id i) {
+        int b = (int)((long long)i*blocks/node_num);
+        while(b>0 && begin(b)>i) b--;
+        while(begin(b+1)<=i) b++;
+        return b;
+    };
+
+    // edges inside each block, edge e being the arcs 2e and 2e+1
+    std::vector<std::vector<int> > edges(blocks);
+    arc_id first = G.get_first_arc();
+    int edge_num = G.get_arc_num()/2;
+    for(int e=0; e<edge_num; e++){
+        node_id i, j;
+        G.get_arc_ends(first+2*e, i, j);
+        int b = block(i);
+        if(b==block(j))
+            edges[b].push_back(e);
+    }
+
+    std::vector<flowtype> flow(blocks, 0);
+    parallelFor(blocks, [&](int b) {
+        node_id n0 = begin(b), n1 = begin(b+1);
+        const std::vector<int>& E = edges[b];
+        typename GraphPool<captype,tcaptype,flowtype>::GraphPtr P = graphPool<captype,tcaptype,flowtype>().acquire(n1-n0, (int)E.size());
+        GraphType& B = *P;
+        B.add_node(n1-n0);
+        for(node_id i=n0; i<n1; i++){
+            tcaptype t = G.get_trcap(i);
+            if(t>0) B.add_tweights(i-n0, t, 0);
+            else if(t<0) B.add_tweights(i-n0, 0, -t);
+        }
+        for(size_t k=0; k<E.size(); k++){
+            arc_id a = first+2*E[k];
+            node_id i, j;
+            G.get_arc_ends(a, i, j);
+            B.add_edge(i-n0, j-n0, G.get_rcap(a), G.get_rcap(a+1));
+        }
+        flow[b] = B.maxflow();
+
+        // back to the residual graph, each block writes its own nodes and arcs
+        arc_id c = B.get_first_arc();
+        for(size_t k=0; k<E.size(); k++){
+            arc_id a = first+2*E[k];
+            G.set_rcap(a, B.get_rcap(c+2*k));
+            G.set_rcap(a+1, B.get_rcap(c+2*k+1));
+        }
+        for(node_id i=n0; i<n1; i++)
+            G.set_trcap(i, B.get_trcap(i-n0));
+    });
+
+    flowtype total = G.maxflow();
+    for(int b=0; b<blocks; b++)
+        total += flow[b];
+    return total;
+}
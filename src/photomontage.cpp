@@ -0,0 +1,517 @@
+#include "photomontage.h"
+#include "seamCost.h"
+#include "parallel.h"
+#include "parallelGraph.h"
+#include "graphPool.h"
+#include "blend.h"
+#include "maskMontage.h"
+
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+
+#define INF numeric_limits<double>::max()/100
+
+using namespace std;
+
+//calculate the total gradient of the image J_0 and store it in G
+void computeGradient(const Image<Vec3b>& J_0, Image<float>& G, bool blur_image)
+{
+    int m = J_0.width(), n = J_0.height();
+
+    Mat J;
+    if(blur_image)
+        GaussianBlur( J_0, J, Size(3,3), 0, 0, BORDER_DEFAULT );
+    else
+        J = J_0;
+
+    Image<float> I_0(m,n,CV_32F);
+    cvtColor(J,I_0,CV_BGR2GRAY);
+
+    int scale = 1;
+    int delta = 0;
+    int ddepth = CV_16S;
+
+    /// Generate grad_x and grad_y
+    Mat grad, grad_x, grad_y;
+    Mat abs_grad_x, abs_grad_y;
+
+    /// Gradient X
+    //Scharr( I_0, grad_x, ddepth, 1, 0, scale, delta, BORDER_DEFAULT );
+    Sobel(I_0, grad_x, ddepth, 1, 0, 3, scale, delta, BORDER_DEFAULT );
+    convertScaleAbs( grad_x, abs_grad_x );
+
+    /// Gradient Y
+    //Scharr( I_0, grad_y, ddepth, 0, 1, scale, delta, BORDER_DEFAULT );
+    Sobel( I_0, grad_y, ddepth, 0, 1, 3, scale, delta, BORDER_DEFAULT );
+    convertScaleAbs( grad_y, abs_grad_y );
+
+    /// Total Gradient (approximate)
+    addWeighted( abs_grad_x, 0.5, abs_grad_y, 0.5, 0, grad );
+    // grad is 8 bits deep, it must be converted rather than read as floats
+    grad.convertTo(G, CV_32F);
+}
+
+const Image<float>& GradientCache::gradient(const Image<Vec3b>& I, bool blur_image){
+    for(size_t k=0; k<entries.size(); k++){
+        const Entry& e = entries[k];
+        if(e.image.data==I.data && e.image.step==I.step && e.image.size()==I.size() && e.blur_image==blur_image){
+            // move it to the front, so the least recently used entry is at the back
+            rotate(entries.begin(), entries.begin()+k, entries.begin()+k+1);
+            return entries.front().gradient;
+        }
+    }
+    Entry e;
+    e.image = I;
+    e.blur_image = blur_image;
+    e.gradient = Image<float>(I.width(), I.height(), CV_32F);
+    computeGradient(I, e.gradient, blur_image);
+    entries.insert(entries.begin(), e);
+    if(entries.size()>capacity)
+        entries.pop_back();
+    return entries.front().gradient;
+}
+
+// computeWeight(i,j,i+1,j,lambda,max_lambda,I1color,I2color,G1,G2offset1,offset2)
+// computes the weight of the edge connecting points (i1,j1) and (i2,j2) in the final image based on their values on coloured images I1 and I2.
+// Consists of a weighted sum of a norm computed using the BGR matrices and a norm computed the matrices of gradients. 
+double computeBGRWeight(int i1, int j1, int i2, int j2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point& offset1, Point& offset2){
+    Scalar p1I1(I1color(i1-offset1.x,j1-offset1.y));
+    Scalar p1I2(I2color(i1-offset2.x,j1-offset2.y));
+    Scalar p2I1(I1color(i2-offset1.x,j2-offset1.y));
+    Scalar p2I2(I2color(i2-offset2.x,j2-offset2.y));
+    return norm(p1I1, p1I2) + norm(p2I1, p2I2);
+}
+
+double computeGradientWeight(int i1, int j1, int i2, int j2, const Image<float>&G1, const Image<float>&G2, Point& offset1, Point& offset2){
+    double p1I1 = G1(i1-offset1.x,j1-offset1.y);
+    double p1I2 = G2(i1-offset2.x,j1-offset2.y);
+    double p2I1 = G1(i2-offset1.x,j2-offset1.y);
+    double p2I2 = G2(i2-offset2.x,j2-offset2.y);
+    //cout << "i1,j1,i2,j2="<<i1<<","<<j1<<","<<i2<<","<<j2<<endl;
+    //cout << "offset1"<<offset1<<",offset2"<<offset2<<endl;
+    //cout << p1I1<<","<<p1I2<<","<<p2I1<<","<<p2I2<<endl;
+    return abs(p1I1-p1I2) + abs(p2I1-p2I2);	
+}
+
+double computeWeight(int i1, int j1, int i2, int j2, int lambda, int max_lambda, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point& offset1, Point& offset2){
+    double c1 = computeBGRWeight(i1,j1,i2,j2,I1color,I2color,offset1,offset2);
+    double c2 = computeGradientWeight(i1,j1,i2,j2,G1,G2,offset1,offset2);
+    if(c1>INF || c1<0) c1=INF;
+    if(c2>INF || c2<0) c2=INF;
+    //cout << "c1="<<c1<<",c2="<<c2<<endl;
+    // same fallback as computeSeamCosts: the BGR distance only
+    if(max_lambda==0){
+        cout << "max_lambda was set to 0, but was supposed to be constant and greater than zero." << endl;
+        max_lambda = 1;
+        lambda = 0;
+    }
+    double weight;
+    if(lambda==0) weight=c1;
+    else if(lambda==max_lambda) weight=c2;
+    else if(c1>=INF-1||c2>=INF-1)
+        weight=INF;
+    else{
+        weight=( (max_lambda-lambda)*c1 + lambda*c2 )/max_lambda;
+        if(weight>=INF-1)
+            weight=INF;
+    }
+    return weight;
+}
+
+// The weight of an edge is the lambda blend of c1(p)+c1(q) and c2(p)+c2(q), where c1 is the BGR distance and c2 the
+// gradient distance of the two images at a point. The blend is linear, so it is the sum of the blended costs of both ends:
+// the costs are computed once per point of the overlap by the vectorized seamCostRow, then summed along each direction.
+void computeSeamCosts(const Rectangle& overlap, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point offset1, Point offset2, int lambda, int max_lambda, Image<float>& horizontal, Image<float>& vertical){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    Rect r1(overlap.p1.x-offset1.x, overlap.p1.y-offset1.y, w, h);
+    Rect r2(overlap.p1.x-offset2.x, overlap.p1.y-offset2.y, w, h);
+    if(max_lambda==0){
+        cout << "max_lambda was set to 0, but was supposed to be constant and greater than zero." << endl;
+        max_lambda = 1;
+        lambda = 0;
+    }
+
+    // cost of each point of the overlap, row by row
+    Image<float> cost(w, h, CV_32F);
+    float wc = float(max_lambda-lambda)/max_lambda, wg = float(lambda)/max_lambda;
+    for(int y=0; y<h; y++)
+        seamCostRow(I1color.ptr<Vec3b>(r1.y+y)+r1.x, I2color.ptr<Vec3b>(r2.y+y)+r2.x, G1.ptr<float>(r1.y+y)+r1.x, G2.ptr<float>(r2.y+y)+r2.x, wc, wg, cost.ptr<float>(y), w);
+
+    horizontal = Image<float>(max(w-1,0), h, CV_32F);
+    vertical = Image<float>(w, max(h-1,0), CV_32F);
+    if(w>1)
+        add(cost.colRange(0,w-1), cost.colRange(1,w), horizontal);
+    if(h>1)
+        add(cost.rowRange(0,h-1), cost.rowRange(1,h), vertical);
+}
+
+// Marks the points of the overlap that are closer than delta to its border as belonging to the image on that side.
+// Points close to both borders (overlap narrower than 2*delta) are left free.
+Image<uchar> overlapConstraints(const Rectangle& overlap, bool right_order1, bool right_order2, int type, int delta){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    Image<uchar> constraints(w, h, CV_8U);
+    // whether the points before the overlap (left for type 1, top for type 2) belong to the first image
+    bool first_side = (type==1) ? right_order1 : right_order2;
+    int length = (type==1) ? w : h;
+    for(int j=0; j<h; j++)
+        for(int i=0; i<w; i++){
+            int k = (type==1) ? i : j;
+            bool before = k < delta, after = k > length-delta;
+            if(before==after)
+                constraints(i,j) = POINT_FREE;
+            else if(before)
+                constraints(i,j) = first_side ? POINT_FIRST_IMAGE : POINT_SECOND_IMAGE;
+            else
+                constraints(i,j) = first_side ? POINT_SECOND_IMAGE : POINT_FIRST_IMAGE;
+        }
+    return constraints;
+}
+
+// floor of p/2, also for negative coordinates
+static Point halfPoint(Point p){
+    return Point(p.x>=0 ? p.x/2 : -((1-p.x)/2), p.y>=0 ? p.y/2 : -((1-p.y)/2));
+}
+
+bool coarseConstraints(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, const Rectangle& overlap, const MontageParams& params, Image<uchar>& constraints){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    if(params.pyramid_levels<=0 || min(w,h) < 4*params.band+4)
+        return false;
+
+    Image<Vec3b> J1, J2;
+    pyrDown(I1color, J1);
+    pyrDown(I2color, J2);
+    Point o1 = halfPoint(offset1), o2 = halfPoint(offset2);
+    MontageParams coarse = params;
+    coarse.pyramid_levels--;
+    coarse.delta = params.delta/2;
+    // only the coarse cut is used, its montage is not blended
+    coarse.blend = BLEND_NONE;
+    Image<Vec3b> montage;
+    Image<float> cut;
+    if(photomontage(J1, J2, o1, o2, montage, cut, coarse)<0)
+        return false;
+    // rectangle of the coarse cut
+    bool ro1=true, ro2=true;
+    Rectangle rec, coarse_overlap;
+    if(!selectRectangles(rectangleOverlap(J1, J2, o1, o2, ro1, ro2), rec, coarse_overlap, params.type))
+        return false;
+
+    // coarse label of each point of the overlap, and the points where it changes
+    Image<uchar> first(w, h, CV_8U);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++){
+            Point c = halfPoint(Point(overlap.p1.x+x, overlap.p1.y+y)) - rec.p1;
+            c.x = min(max(c.x, 0), cut.width()-1);
+            c.y = min(max(c.y, 0), cut.height()-1);
+            first(x,y) = cut(c.x,c.y) > 0.5f;
+        }
+    Mat seam = Mat::zeros(h, w, CV_8U);
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++)
+            if((x<w-1 && first(x,y)!=first(x+1,y)) || (y<h-1 && first(x,y)!=first(x,y+1)))
+                seam.at<uchar>(y,x) = 255;
+    Mat band;
+    dilate(seam, band, getStructuringElement(MORPH_RECT, Size(2*params.band+1, 2*params.band+1)));
+
+    for(int y=0; y<h; y++)
+        for(int x=0; x<w; x++)
+            if(constraints(x,y)==POINT_FREE && !band.at<uchar>(y,x))
+                constraints(x,y) = first(x,y) ? POINT_FIRST_IMAGE : POINT_SECOND_IMAGE;
+    return true;
+}
+
+int numberFreePoints(const Image<uchar>& constraints, Image<int>& nodes){
+    nodes = Image<int>(constraints.width(), constraints.height(), CV_32S);
+    int node_num = 0;
+    for(int j=0; j<constraints.height(); j++)
+        for(int i=0; i<constraints.width(); i++)
+            nodes(i,j) = (constraints(i,j)==POINT_FREE) ? node_num++ : -1;
+    return node_num;
+}
+
+// The graph is built by bands of rows on parallelThreads() threads. The free points are numbered row by row, so each
+// band owns a range of nodes: it sets the edges going right or down from its points into slots reserved beforehand and
+// links the arcs whose origin it owns, and it sets the t-links of its points from their fixed neighbours. The arcs
+// going up from the first row of a band are linked afterwards, no locking is needed.
+template <typename captype, typename tcaptype, typename flowtype>
+void buildGraphFromRectangle(Graph<captype,tcaptype,flowtype>& G, const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, int node_num, const Image<float>& horizontal, const Image<float>& vertical, double scale){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    G.reset();
+    if(node_num==0)
+        return;
+    G.add_node(node_num);
+
+    int bands = min(h, parallelThreads());
+    // edges between free points starting in each band
+    vector<int> first_edge(bands+1, 0);
+    parallelFor(bands, [&](int b) {
+        int count = 0;
+        for(int y=b*h/bands; y<(b+1)*h/bands; y++)
+            for(int x=0; x<w; x++)
+                if(nodes(x,y)>=0){
+                    if(x<w-1 && nodes(x+1,y)>=0) count++;
+                    if(y<h-1 && nodes(x,y+1)>=0) count++;
+                }
+        first_edge[b+1] = count;
+    });
+    for(int b=0; b<bands; b++)
+        first_edge[b+1] += first_edge[b];
+    int e0 = G.reserve_edges(first_edge[bands]);
+
+    vector<flowtype> flow(bands, 0);
+    vector<vector<int> > next_band_arcs(bands);
+    parallelFor(bands, [&](int b) {
+        int y0 = b*h/bands, y1 = (b+1)*h/bands;
+        int e = e0+first_edge[b];
+        for(int y=y0; y<y1; y++)
+            for(int x=0; x<w; x++){
+                int u = nodes(x,y);
+                if(u<0)
+                    continue;
+                if(x<w-1 && nodes(x+1,y)>=0){
+                    captype c = quantizeWeight<captype>(horizontal(x,y), scale);
+                    G.set_edge(e, u, nodes(x+1,y), c, c);
+                    G.link_edge(e++);
+                }
+                if(y<h-1 && nodes(x,y+1)>=0){
+                    captype c = quantizeWeight<captype>(vertical(x,y), scale);
+                    G.set_edge(e, u, nodes(x,y+1), c, c);
+                    G.link_edge(e, true, y+1<y1);
+                    if(y+1==y1)
+                        next_band_arcs[b].push_back(e);
+                    e++;
+                }
+                // cutting the edge towards a fixed point means giving this point the other label
+                tcaptype t[3] = {0, 0, 0};
+                if(x>0 && nodes(x-1,y)<0) t[constraints(x-1,y)] += quantizeWeight<captype>(horizontal(x-1,y), scale);
+                if(x<w-1 && nodes(x+1,y)<0) t[constraints(x+1,y)] += quantizeWeight<captype>(horizontal(x,y), scale);
+                if(y>0 && nodes(x,y-1)<0) t[constraints(x,y-1)] += quantizeWeight<captype>(vertical(x,y-1), scale);
+                if(y<h-1 && nodes(x,y+1)<0) t[constraints(x,y+1)] += quantizeWeight<captype>(vertical(x,y), scale);
+                if(t[POINT_FIRST_IMAGE]!=0 || t[POINT_SECOND_IMAGE]!=0)
+                    flow[b] += G.set_tweights(u, t[POINT_FIRST_IMAGE], t[POINT_SECOND_IMAGE]);
+            }
+    });
+    for(int b=0; b<bands; b++){
+        G.add_flow(flow[b]);
+        for(size_t k=0; k<next_band_arcs[b].size(); k++)
+            G.link_edge(next_band_arcs[b][k], false, true);
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+Graph<captype,tcaptype,flowtype>createGraphFromRectangle(const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, int node_num, const Image<float>& horizontal, const Image<float>& vertical, double scale){
+    Graph<captype,tcaptype,flowtype> G(node_num, 2*node_num);
+    buildGraphFromRectangle(G, overlap, constraints, nodes, node_num, horizontal, vertical, scale);
+    return G;
+}
+
+// Each point sets the arcs of the edges going right or down from it, and its own t-links, so the bands of rows are
+// built in parallel without locking. The flow of the t-links is summed by band and added to the graph afterwards.
+template <typename captype, typename tcaptype, typename flowtype>
+GridGraph<captype,tcaptype,flowtype> createGridGraphFromRectangle(const Rectangle& overlap, const Image<uchar>& constraints, const Image<float>& horizontal, const Image<float>& vertical, double scale){
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    GridGraph<captype,tcaptype,flowtype> G(w, h);
+    int bands = min(h, parallelThreads());
+    vector<flowtype> flow(bands, 0);
+    parallelFor(bands, [&](int b) {
+        for(int y=b*h/bands; y<(b+1)*h/bands; y++)
+            for(int x=0; x<w; x++){
+                if(constraints(x,y)!=POINT_FREE)
+                    continue;
+                if(x<w-1 && constraints(x+1,y)==POINT_FREE){
+                    captype c = quantizeWeight<captype>(horizontal(x,y), scale);
+                    G.add_edge(G.node(x,y), G.node(x+1,y), c, c);
+                }
+                if(y<h-1 && constraints(x,y+1)==POINT_FREE){
+                    captype c = quantizeWeight<captype>(vertical(x,y), scale);
+                    G.add_edge(G.node(x,y), G.node(x,y+1), c, c);
+                }
+                tcaptype t[3] = {0, 0, 0};
+                if(x>0 && constraints(x-1,y)!=POINT_FREE) t[constraints(x-1,y)] += quantizeWeight<captype>(horizontal(x-1,y), scale);
+                if(x<w-1 && constraints(x+1,y)!=POINT_FREE) t[constraints(x+1,y)] += quantizeWeight<captype>(horizontal(x,y), scale);
+                if(y>0 && constraints(x,y-1)!=POINT_FREE) t[constraints(x,y-1)] += quantizeWeight<captype>(vertical(x,y-1), scale);
+                if(y<h-1 && constraints(x,y+1)!=POINT_FREE) t[constraints(x,y+1)] += quantizeWeight<captype>(vertical(x,y), scale);
+                if(t[POINT_FIRST_IMAGE]!=0 || t[POINT_SECOND_IMAGE]!=0)
+                    flow[b] += G.set_tweights(G.node(x,y), t[POINT_FIRST_IMAGE], t[POINT_SECOND_IMAGE]);
+            }
+    });
+    for(int b=0; b<bands; b++)
+        G.add_flow(flow[b]);
+    return G;
+}
+
+bool selectRectangles(const vector<Rectangle>&combined_coordinates, Rectangle& rec, Rectangle& overlap, int type){
+    if(type==1)
+        rec = combined_coordinates[0]; // coordinates of rectangle in the horizontal
+    else if(type==2)
+        rec =  combined_coordinates[1]; // coordinates of rectangle in the vertical
+    else{
+        cout << "wrong type given " << endl;
+        return false;
+    }
+    overlap = combined_coordinates[2]; // overlapped rectangle
+    return true;
+}
+
+// generateImagesFromGraphAndRec for Graph and GridGraph
+template <class GraphType>
+static void fillImagesFromGraph(Image<Vec3b>&label, Image<float>&label2, const GraphType&G, const Rectangle& rec, const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, bool right_order1, bool right_order2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, int type, LabelMapWriter* label_map){
+    bool first_side = (type==1) ? right_order1 : right_order2;
+    if(label_map && !label_map->open(rec.p2.x-rec.p1.x, rec.p2.y-rec.p1.y, rec.p1))
+        label_map = NULL;
+    vector<uchar> row(rec.p2.x-rec.p1.x);
+    for (int j=rec.p1.y;j<rec.p2.y;j++){
+        for (int i=rec.p1.x;i<rec.p2.x;i++){
+            bool from_first;
+            // points of the overlap come from the cut, unless they were fixed
+            if(i>=overlap.p1.x && i<overlap.p2.x && j>=overlap.p1.y && j<overlap.p2.y){
+                int x = i-overlap.p1.x, y = j-overlap.p1.y;
+                if(constraints(x,y)==POINT_FREE)
+                    from_first = G.what_segment(nodes(x,y)) == GraphType::SOURCE;
+                else
+                    from_first = constraints(x,y)==POINT_FIRST_IMAGE;
+            }
+            // here we assign points that belong to only one of the images to this image
+            else if(i<overlap.p1.x || j<overlap.p1.y)
+                from_first = first_side;
+            else
+                from_first = !first_side;
+            label(i-rec.p1.x,j-rec.p1.y) = from_first ? I1color(i-offset1.x,j-offset1.y) : I2color(i-offset2.x,j-offset2.y);
+            label2(i-rec.p1.x,j-rec.p1.y) = from_first ? 1 : 0;
+            row[i-rec.p1.x] = from_first;
+        }
+        // the label map is written as the rows are done
+        if(label_map)
+            label_map->writeRow(&row[0]);
+    }
+    if(label_map)
+        label_map->close();
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void generateImagesFromGraphAndRec(Image<Vec3b>&label, Image<float>&label2, const Graph<captype,tcaptype,flowtype>&G, const Rectangle& rec, const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, bool right_order1, bool right_order2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, int type, LabelMapWriter* label_map){
+    fillImagesFromGraph(label, label2, G, rec, overlap, constraints, nodes, right_order1, right_order2, I1color, I2color, offset1, offset2, type, label_map);
+}
+
+// cut of the overlap with capacities of type captype, the returned flow is in units of computeWeight
+template <typename captype, typename tcaptype, typename flowtype>
+static double solveMontage(const Rectangle& rec, const Rectangle& overlap, bool right_order1, bool right_order2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point offset1, Point offset2, Image<Vec3b>&montage, Image<float>&cut, const MontageParams& params, LabelMapWriter* label_map){
+    // only the points of the overlap can change label, so only they appear in the graph
+    Image<uchar> constraints = overlapConstraints(overlap, right_order1, right_order2, params.type, params.delta);
+    // in pyramid mode, only a band around the seam found at the coarser level stays free
+    coarseConstraints(I1color, I2color, offset1, offset2, overlap, params, constraints);
+    Image<float> horizontal, vertical;
+    computeSeamCosts(overlap, I1color, I2color, G1, G2, offset1, offset2, params.lambda, params.max_lambda, horizontal, vertical);
+    montage = Image<Vec3b>(rec.p2.x-rec.p1.x,rec.p2.y-rec.p1.y, DataType<Vec3b>::type);
+    cut = Image<float>(rec.p2.x-rec.p1.x,rec.p2.y-rec.p1.y, DataType<float>::type);
+    Image<int> nodes;
+    double flow, scale = capacityScale<captype>(params.capacity_scale);
+    if(params.solver==SOLVER_GRID){
+        GridGraph<captype,tcaptype,flowtype> G = createGridGraphFromRectangle<captype,tcaptype,flowtype>(overlap, constraints, horizontal, vertical, scale);
+        flow = G.maxflow();
+        nodes = Image<int>(constraints.width(), constraints.height(), CV_32S);
+        for(int y=0; y<constraints.height(); y++)
+            for(int x=0; x<constraints.width(); x++)
+                nodes(x,y) = G.node(x,y);
+        fillImagesFromGraph(montage, cut, G, rec, overlap, constraints, nodes, right_order1, right_order2, I1color, I2color, offset1, offset2, params.type, label_map);
+    }
+    else{
+        int node_num = numberFreePoints(constraints, nodes);
+        typename GraphPool<captype,tcaptype,flowtype>::GraphPtr G = graphPool<captype,tcaptype,flowtype>().acquire(node_num, 2*node_num);
+        buildGraphFromRectangle(*G, overlap, constraints, nodes, node_num, horizontal, vertical, scale);
+        flow = (params.solver==SOLVER_PARALLEL) ? parallelMaxflow(*G) : G->maxflow();
+        generateImagesFromGraphAndRec(montage, cut, *G, rec, overlap, constraints, nodes, right_order1, right_order2, I1color, I2color, offset1, offset2, params.type, label_map);
+    }
+    if(numeric_limits<captype>::is_integer)
+        flow /= scale;
+    return flow;
+}
+
+bool prepareMontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, const MontageParams& params, GradientCache* cache, Rectangle& rec, Rectangle& overlap, bool& right_order1, bool& right_order2, Image<float>& G1, Image<float>& G2){
+    right_order1=true;
+    right_order2=true;
+    vector<Rectangle>combined_coordinates = rectangleOverlap(I1color, I2color, offset1, offset2, right_order1, right_order2);
+    if(!selectRectangles(combined_coordinates, rec, overlap, params.type))
+        return false;
+    if(overlap.p2.x<=overlap.p1.x || overlap.p2.y<=overlap.p1.y){
+        cout << "the images do not overlap" << endl;
+        return false;
+    }
+    if(cache){
+        G1 = cache->gradient(I1color, params.blur_image);
+        G2 = cache->gradient(I2color, params.blur_image);
+    }
+    else{
+        G1 = Image<float>(I1color.width(), I1color.height(), CV_32F);
+        computeGradient(I1color, G1, params.blur_image);
+        G2 = Image<float>(I2color.width(), I2color.height(), CV_32F);
+        computeGradient(I2color, G2, params.blur_image);
+    }
+    return true;
+}
+
+double photomontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, Image<Vec3b>&montage, Image<float>&cut, const MontageParams& params, GradientCache* cache, LabelMapWriter* label_map){
+    if(params.overlap==OVERLAP_MASK){
+        // canvas from the top left corner of the two images
+        Point corner(min(offset1.x, offset2.x), min(offset1.y, offset2.y));
+        Size canvas(max(offset1.x+I1color.width(), offset2.x+I2color.width())-corner.x, max(offset1.y+I1color.height(), offset2.y+I2color.height())-corner.y);
+        TranslatedSource S1(I1color, offset1-corner, canvas, params.blur_image, cache), S2(I2color, offset2-corner, canvas, params.blur_image, cache);
+        Point origin;
+        double flow = maskPhotomontage(S1, S2, montage, cut, origin, params);
+        if(flow>=0 && label_map && label_map->open(cut.width(), cut.height(), corner+origin)){
+            vector<uchar> row(cut.width());
+            for(int y=0; y<cut.height(); y++){
+                for(int x=0; x<cut.width(); x++)
+                    row[x] = cut(x,y)!=0;
+                label_map->writeRow(&row[0]);
+            }
+            label_map->close();
+        }
+        return flow;
+    }
+    bool right_order1, right_order2;
+    Rectangle overlap, rec;
+    Image<float>G1, G2;
+    if(!prepareMontage(I1color, I2color, offset1, offset2, params, cache, rec, overlap, right_order1, right_order2, G1, G2))
+        return -1;
+    double flow;
+    switch(params.capacity){
+    case CAPACITY_FLOAT:
+        flow = solveMontage<float,float,float>(rec, overlap, right_order1, right_order2, I1color, I2color, G1, G2, offset1, offset2, montage, cut, params, label_map);
+        break;
+    case CAPACITY_INT:
+        flow = solveMontage<int,int,int>(rec, overlap, right_order1, right_order2, I1color, I2color, G1, G2, offset1, offset2, montage, cut, params, label_map);
+        break;
+    case CAPACITY_SHORT:
+        flow = solveMontage<short,int,int>(rec, overlap, right_order1, right_order2, I1color, I2color, G1, G2, offset1, offset2, montage, cut, params, label_map);
+        break;
+    default:
+        flow = solveMontage<double,double,double>(rec, overlap, right_order1, right_order2, I1color, I2color, G1, G2, offset1, offset2, montage, cut, params, label_map);
+    }
+    if(params.blend==BLEND_POISSON)
+        poissonBlend(I1color, I2color, offset1, offset2, rec, cut, montage);
+    else if(params.blend==BLEND_MULTIBAND)
+        multibandBlend(I1color, I2color, offset1, offset2, rec, cut, params.type, params.blend_band, montage);
+    return flow;
+}
+
+// Instantiations: same capacity types as maxflow/instances.inc
+template Graph<int,int,int> createGraphFromRectangle<int,int,int>(const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template void buildGraphFromRectangle<int,int,int>(Graph<int,int,int>&, const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template GridGraph<int,int,int> createGridGraphFromRectangle<int,int,int>(const Rectangle&, const Image<uchar>&, const Image<float>&, const Image<float>&, double);
+template Graph<short,int,int> createGraphFromRectangle<short,int,int>(const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template void buildGraphFromRectangle<short,int,int>(Graph<short,int,int>&, const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template GridGraph<short,int,int> createGridGraphFromRectangle<short,int,int>(const Rectangle&, const Image<uchar>&, const Image<float>&, const Image<float>&, double);
+template Graph<float,float,float> createGraphFromRectangle<float,float,float>(const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template void buildGraphFromRectangle<float,float,float>(Graph<float,float,float>&, const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template GridGraph<float,float,float> createGridGraphFromRectangle<float,float,float>(const Rectangle&, const Image<uchar>&, const Image<float>&, const Image<float>&, double);
+template Graph<double,double,double> createGraphFromRectangle<double,double,double>(const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template void buildGraphFromRectangle<double,double,double>(Graph<double,double,double>&, const Rectangle&, const Image<uchar>&, const Image<int>&, int, const Image<float>&, const Image<float>&, double);
+template GridGraph<double,double,double> createGridGraphFromRectangle<double,double,double>(const Rectangle&, const Image<uchar>&, const Image<float>&, const Image<float>&, double);
+template void generateImagesFromGraphAndRec<int,int,int>(Image<Vec3b>&, Image<float>&, const Graph<int,int,int>&, const Rectangle&, const Rectangle&, const Image<uchar>&, const Image<int>&, bool, bool, const Image<Vec3b>&, const Image<Vec3b>&, Point, Point, int, LabelMapWriter*);
+template void generateImagesFromGraphAndRec<short,int,int>(Image<Vec3b>&, Image<float>&, const Graph<short,int,int>&, const Rectangle&, const Rectangle&, const Image<uchar>&, const Image<int>&, bool, bool, const Image<Vec3b>&, const Image<Vec3b>&, Point, Point, int, LabelMapWriter*);
+template void generateImagesFromGraphAndRec<float,float,float>(Image<Vec3b>&, Image<float>&, const Graph<float,float,float>&, const Rectangle&, const Rectangle&, const Image<uchar>&, const Image<int>&, bool, bool, const Image<Vec3b>&, const Image<Vec3b>&, Point, Point, int, LabelMapWriter*);
+template void generateImagesFromGraphAndRec<double,double,double>(Image<Vec3b>&, Image<float>&, const Graph<double,double,double>&, const Rectangle&, const Rectangle&, const Image<uchar>&, const Image<int>&, bool, bool, const Image<Vec3b>&, const Image<Vec3b>&, Point, Point, int, LabelMapWriter*);
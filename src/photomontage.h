@@ -0,0 +1,167 @@
+#pragma once
+
+#include "image.h"
+#include "rectangleOverlap.h"
+#include "maxflow/graph.h"
+#include "gridGraph.h"
+#include "labelMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Capacity types of the seam graph, as instantiated in maxflow/instances.inc.
+// Narrower capacities use less memory per arc and node, integer ones are fixed-point.
+enum CapacityMode {
+    CAPACITY_DOUBLE, // Graph<double,double,double>
+    CAPACITY_FLOAT,  // Graph<float,float,float>
+    CAPACITY_INT,    // Graph<int,int,int>
+    CAPACITY_SHORT   // Graph<short,int,int>
+};
+
+// Maxflow solvers of the seam graph
+enum MaxflowSolver {
+    SOLVER_BK,       // Graph::maxflow(), one thread
+    SOLVER_PARALLEL, // parallelMaxflow() of parallelGraph.h, same flow on parallelThreads() threads
+    SOLVER_GRID      // GridGraph of gridGraph.h over the whole overlap, same flow with less memory
+};
+
+// Blending of the montage after the cut
+enum BlendMode {
+    BLEND_NONE,   // each point has the color of the image it comes from
+    BLEND_POISSON,  // poissonBlend() of blend.h, gradient-domain blending over the whole montage
+    BLEND_MULTIBAND // multibandBlend() of blend.h, Laplacian pyramids over a band around the seam
+};
+
+// Shape of the overlap of two images
+enum OverlapMode {
+    OVERLAP_RECTANGLE, // the rectangles of rectangleOverlap, cut across the direction given by type
+    OVERLAP_MASK       // maskPhotomontage() of maskMontage.h, over the intersection of the masks of the images
+};
+
+// Parameters of a montage of two images
+// type: 1 combines the images horizontally, 2 vertically
+// delta: width of the band close to the border of the overlap that is assigned to the closest image
+// lambda/max_lambda: weight of the gradient norm with respect to the BGR norm in the edge weights
+// blur_image: blur the images before computing their gradients
+// capacity: type of the capacities of the graph, see CapacityMode
+// capacity_scale: for integer capacities, the weights are rounded to multiples of 1/capacity_scale (lowered by
+// capacityScale when the largest weight would saturate the type)
+// pyramid_levels: number of times the images are halved to find a coarse seam first (0 solves the whole overlap)
+// band: in pyramid mode, distance to the upsampled coarse seam of the points that stay free at each level
+// solver: maxflow solver, see MaxflowSolver
+// blend: blending of the montage, see BlendMode
+// blend_band: in multiband mode, distance to the seam of the points that are blended
+// overlap: shape of the overlap, see OverlapMode
+struct MontageParams {
+    int type;
+    int delta;
+    int lambda;
+    int max_lambda;
+    bool blur_image;
+    int capacity;
+    double capacity_scale;
+    int pyramid_levels;
+    int band;
+    int solver;
+    int blend;
+    int blend_band;
+    int overlap;
+    MontageParams() : type(1), delta(5), lambda(0), max_lambda(10), blur_image(true), capacity(CAPACITY_DOUBLE), capacity_scale(16), pyramid_levels(0), band(8), solver(SOLVER_BK), blend(BLEND_NONE), blend_band(32), overlap(OVERLAP_RECTANGLE) {}
+};
+
+//calculate the total gradient of the image J_0 and store it in G
+void computeGradient(const Image<Vec3b>& J_0, Image<float>& G, bool blur_image);
+
+// Keeps the gradients of the last images, so that changing the offsets, delta or lambda does not compute them again.
+// Images are identified by their data: an entry keeps a reference on it, so the buffer cannot be reused for another
+// image while it is cached. Images modified in place must be removed with clear().
+class GradientCache {
+public:
+    GradientCache(size_t capacity=4) : capacity(capacity) {}
+    const Image<float>& gradient(const Image<Vec3b>& I, bool blur_image);
+    void clear() { entries.clear(); }
+private:
+    struct Entry {
+        Image<Vec3b> image;
+        bool blur_image;
+        Image<float> gradient;
+    };
+    vector<Entry> entries; // most recently used first
+    size_t capacity;
+};
+
+// weight of the edge connecting points (i1,j1) and (i2,j2) of the final image
+double computeBGRWeight(int i1, int j1, int i2, int j2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point& offset1, Point& offset2);
+double computeGradientWeight(int i1, int j1, int i2, int j2, const Image<float>&G1, const Image<float>&G2, Point& offset1, Point& offset2);
+double computeWeight(int i1, int j1, int i2, int j2, int lambda, int max_lambda, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point& offset1, Point& offset2);
+
+// constraints on the points of the overlap
+enum { POINT_FREE=0, POINT_FIRST_IMAGE=1, POINT_SECOND_IMAGE=2 };
+
+// points of the overlap closer than delta to its border in the direction given by type are fixed to the image on that side
+Image<uchar> overlapConstraints(const Rectangle& overlap, bool right_order1, bool right_order2, int type, int delta);
+// Pyramid mode: solves the montage of the images halved with pyrDown (recursively, with one level less), upsamples
+// its cut to the overlap and fixes the free points farther than params.band from the coarse seam to their coarse label.
+// Returns false, leaving the constraints unchanged, if the overlap is too small for the coarse montage to help.
+bool coarseConstraints(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, const Rectangle& overlap, const MontageParams& params, Image<uchar>& constraints);
+// gives a node number to each free point of the overlap (-1 for fixed points) and returns the number of nodes
+int numberFreePoints(const Image<uchar>& constraints, Image<int>& nodes);
+
+// weights of all the edges of the overlap, same values as computeWeight: horizontal(x,y) is the weight of the edge
+// between the points (x,y) and (x+1,y) of the overlap, vertical(x,y) the one between (x,y) and (x,y+1)
+void computeSeamCosts(const Rectangle& overlap, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, const Image<float>&G1, const Image<float>&G2, Point offset1, Point offset2, int lambda, int max_lambda, Image<float>& horizontal, Image<float>& vertical);
+
+// largest weight of an edge: twice the largest BGR distance of a point (the gradient distance is at most 2*255)
+const double max_edge_weight = 2*255*1.7320508075688772;
+
+// Fixed-point scale of the capacities of type captype for the requested scale: lowered for integer types so that
+// max_edge_weight does not saturate in quantizeWeight (short capacities allow a scale of 9 at most), which would
+// change the cost of the expensive edges and the minimum cut.
+template <typename captype> double capacityScale(double scale){
+    if(!std::numeric_limits<captype>::is_integer)
+        return scale;
+    return std::min(scale, (double)(std::numeric_limits<captype>::max()/4)/max_edge_weight);
+}
+
+// converts a weight to the capacity type of the graph: floating point capacities are kept as they are,
+// integer ones are fixed-point values with 1/scale precision, saturated well below the maximum of the type
+template <typename captype> captype quantizeWeight(double weight, double scale){
+    if(!std::numeric_limits<captype>::is_integer)
+        return (captype)std::min(weight, (double)std::numeric_limits<captype>::max()/100);
+    return (captype)std::min(std::floor(weight*scale+0.5), (double)std::numeric_limits<captype>::max()/4);
+}
+
+// builds the graph over the free points of the overlap only, with the weights given by computeSeamCosts:
+// the edges towards fixed points become t-links. Integer capacities hold the weights multiplied by scale.
+template <typename captype, typename tcaptype, typename flowtype>
+Graph<captype,tcaptype,flowtype>createGraphFromRectangle(const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, int node_num, const Image<float>& horizontal, const Image<float>& vertical, double scale=1);
+
+// same graph built in G, which is reset first and keeps its memory (see graphPool.h)
+template <typename captype, typename tcaptype, typename flowtype>
+void buildGraphFromRectangle(Graph<captype,tcaptype,flowtype>& G, const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, int node_num, const Image<float>& horizontal, const Image<float>& vertical, double scale=1);
+
+// same graph as createGraphFromRectangle as a GridGraph of the size of the overlap: the fixed points are isolated
+// nodes, the free point (x,y) is the node G.node(x,y)
+template <typename captype, typename tcaptype, typename flowtype>
+GridGraph<captype,tcaptype,flowtype> createGridGraphFromRectangle(const Rectangle& overlap, const Image<uchar>& constraints, const Image<float>& horizontal, const Image<float>& vertical, double scale=1);
+
+// picks the rectangle of the montage for the given type among the ones returned by rectangleOverlap
+bool selectRectangles(const vector<Rectangle>&combined_coordinates, Rectangle& rec, Rectangle& overlap, int type);
+
+// fills the montage (label) and the cut (label2, 1 where the pixel comes from I1color) from the segmentation of the graph;
+// the rows of the cut are also written to label_map when it is not NULL
+template <typename captype, typename tcaptype, typename flowtype>
+void generateImagesFromGraphAndRec(Image<Vec3b>&label, Image<float>&label2, const Graph<captype,tcaptype,flowtype>&G, const Rectangle& rec, const Rectangle& overlap, const Image<uchar>& constraints, const Image<int>& nodes, bool right_order1, bool right_order2, const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, int type, LabelMapWriter* label_map = NULL);
+
+// montage rectangle, overlap and gradients of the two images: the steps common to all the ways of solving a montage.
+// Returns false if the montage cannot be done (wrong type, no overlap).
+bool prepareMontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, const MontageParams& params, GradientCache* cache, Rectangle& rec, Rectangle& overlap, bool& right_order1, bool& right_order2, Image<float>& G1, Image<float>& G2);
+
+// Combines I1color and I2color, placed at offset1 and offset2, along a minimum cut of their overlap.
+// montage receives the combined image and cut the label map (1 where the pixel comes from I1color, 0 otherwise).
+// The gradients are taken from cache when one is given. With params.blend, montage is blended after the cut.
+// With OVERLAP_MASK, montage and cut cover the bounding box of both images (see maskPhotomontage).
+// The cut is also written to label_map when it is not NULL (see labelMap.h).
+// Returns the value of the cut, or -1 if the montage could not be computed.
+double photomontage(const Image<Vec3b>&I1color, const Image<Vec3b>&I2color, Point offset1, Point offset2, Image<Vec3b>&montage, Image<float>&cut, const MontageParams& params = MontageParams(), GradientCache* cache = NULL, LabelMapWriter* label_map = NULL);
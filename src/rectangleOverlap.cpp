@@ -1,6 +1,5 @@
 
 #include "rectangleOverlap.h"
-#include <opencv2/highgui/highgui.hpp>
 #include <iostream>
 #include <algorithm>
 
@@ -50,8 +49,12 @@ ________|_______________________|_____
 
 
 vector<Rectangle> rectangleOverlap (const Image<Vec3b>& I1, const Image<Vec3b>& I2, Point offset1, Point offset2, bool& position1, bool& position2) {
-    pair<Point, Point> i1 (Point(offset1), Point(I1.width()+offset1.x, I1.height()+offset1.y));   
-    pair<Point, Point> i2 (Point(offset2), Point(I2.width()+offset2.x, I2.height()+offset2.y));   
+    return rectangleOverlap(I1.size(), I2.size(), offset1, offset2, position1, position2);
+}
+
+vector<Rectangle> rectangleOverlap (Size size1, Size size2, Point offset1, Point offset2, bool& position1, bool& position2) {
+    pair<Point, Point> i1 (Point(offset1), Point(size1.width+offset1.x, size1.height+offset1.y));   
+    pair<Point, Point> i2 (Point(offset2), Point(size2.width+offset2.x, size2.height+offset2.y));   
 
     vector<Rectangle> r(3);
 
@@ -117,6 +120,7 @@ vector<Rectangle> rectangleOverlap (const Image<Vec3b>& I1, const Image<Vec3b>&
 
 //#define TEST
 #ifdef TEST
+#include <opencv2/highgui/highgui.hpp>
 
 int main (int argc, char *argv[]) {
     Image<Vec3b> Icolor1 = imread(argv[1]);
@@ -9,3 +9,5 @@ typedef struct Rectangle {
 } Rectangle;
 
 vector<Rectangle> rectangleOverlap (const Image<Vec3b>& I1, const Image<Vec3b>& I2, Point offset1, Point offset2, bool& position1, bool& position2);
+// same from the sizes of the images only
+vector<Rectangle> rectangleOverlap (Size size1, Size size2, Point offset1, Point offset2, bool& position1, bool& position2);
@@ -0,0 +1,83 @@
+#include "registration.h"
+
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+static Image<float> greyImage(const Image<Vec3b>& I){
+    Mat grey;
+    cvtColor(I, grey, COLOR_BGR2GRAY);
+    Image<float> G;
+    grey.convertTo(G, CV_32F);
+    return G;
+}
+
+// strongest Harris corners far enough from the border for an NCC window
+static vector<Point> strongestCorners(const Image<float>& I, const RegistrationParams& params){
+    Image<float> H;
+    cornerHarris(I, H, 10, 3, 0.04);
+    double max_response;
+    minMaxLoc(H, NULL, &max_response);
+    if(max_response<=0)
+        return vector<Point>();
+    vector<Point> corners = harris(I, params.harris_threshold*max_response, params.window);
+    sort(corners.begin(), corners.end(), [&](const Point& a, const Point& b) { return H(a)>H(b); });
+    if((int)corners.size()>params.max_corners)
+        corners.resize(params.max_corners);
+    return corners;
+}
+
+bool estimateOffsets(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point& offset1, Point& offset2, const RegistrationParams& params){
+    Image<float> I1 = greyImage(I1color), I2 = greyImage(I2color);
+    vector<Point> c1 = strongestCorners(I1, params), c2 = strongestCorners(I2, params);
+    if(c1.empty() || c2.empty()){
+        cout << "registration: no corner found" << endl;
+        return false;
+    }
+    int n = params.window;
+    NCCImage N1(I1, n), N2(I2, n);
+
+    // best match of each corner in the other image
+    vector<vector<double> > ncc(c1.size(), vector<double>(c2.size()));
+    for(size_t i=0; i<c1.size(); i++)
+        for(size_t j=0; j<c2.size(); j++)
+            ncc[i][j] = NCC(N1, c1[i], N2, c2[j]);
+    vector<int> best2(c2.size(), -1);
+    for(size_t j=0; j<c2.size(); j++)
+        for(size_t i=0; i<c1.size(); i++)
+            if(best2[j]<0 || ncc[i][j]>ncc[best2[j]][j])
+                best2[j] = i;
+    vector<Point> d;
+    for(size_t i=0; i<c1.size(); i++){
+        int best = max_element(ncc[i].begin(), ncc[i].end())-ncc[i].begin();
+        if(ncc[i][best]>=params.min_ncc && best2[best]==(int)i)
+            d.push_back(c1[i]-c2[best]);
+    }
+
+    // translation with the most matches within tolerance
+    int votes = 0;
+    Point2d translation;
+    for(size_t k=0; k<d.size(); k++){
+        int count = 0;
+        Point2d sum(0, 0);
+        for(size_t l=0; l<d.size(); l++)
+            if(abs(d[l].x-d[k].x)<=params.tolerance && abs(d[l].y-d[k].y)<=params.tolerance){
+                count++;
+                sum += Point2d(d[l].x, d[l].y);
+            }
+        if(count>votes){
+            votes = count;
+            translation = sum*(1./count);
+        }
+    }
+    cout << "registration: " << c1.size() << " and " << c2.size() << " corners, " << d.size() << " matches, " << votes << " agree" << endl;
+    if(votes<params.min_votes){
+        cout << "registration: not enough matches agree on a translation" << endl;
+        return false;
+    }
+    Point t(cvRound(translation.x), cvRound(translation.y));
+    offset1 = Point(max(0, -t.x), max(0, -t.y));
+    offset2 = offset1+t;
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "image.h"
+
+// Parameters of the registration of two images
+// harris_threshold: corners are kept where the Harris response is above this fraction of its maximum
+// max_corners: strongest corners kept in each image
+// window: half size n of the (2n+1)x(2n+1) windows compared by NCC
+// min_ncc: matches with a lower correlation are dropped
+// tolerance: distance in pixels under which two matches vote for the same translation
+// min_votes: smallest number of matches that must agree on the translation
+struct RegistrationParams {
+    double harris_threshold;
+    int max_corners;
+    int window;
+    double min_ncc;
+    int tolerance;
+    int min_votes;
+    RegistrationParams() : harris_threshold(0.01), max_corners(500), window(7), min_ncc(0.8), tolerance(2), min_votes(4) {}
+};
+
+// Translation between two views of the same scene: Harris corners of both images are matched by NCC (with the sums
+// of the windows read from integral images, see NCCImage), keeping a match only when each point is the best one of the other; each match votes for
+// the translation d = m1-m2 and the translation with the most votes within tolerance wins, averaged over them.
+// offset1 and offset2 receive the places of the images in the montage, d = offset2-offset1, both with non-negative
+// coordinates and one of them at 0 on each axis, as expected by photomontage.
+// Returns false, printing why, if not enough matches agree.
+bool estimateOffsets(const Image<Vec3b>& I1color, const Image<Vec3b>& I2color, Point& offset1, Point& offset2, const RegistrationParams& params = RegistrationParams());
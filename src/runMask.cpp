@@ -0,0 +1,213 @@
+#include "runMask.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+RunMask::RunMask(Size size) : w(size.width), h(size.height), row_first(1, 0), rank(1, 0) {}
+
+void RunMask::addRow(const vector<Run>& row){
+    for(size_t k=0; k<row.size(); k++){
+        run_list.push_back(row[k]);
+        rank.push_back(rank.back()+row[k].x1-row[k].x0);
+    }
+    row_first.push_back((int)run_list.size());
+}
+
+RunMask RunMask::rectangle(Size size, Rect r){
+    RunMask M(size);
+    r &= Rect(0, 0, size.width, size.height);
+    vector<Run> row, none;
+    if(r.width>0){
+        Run run = {r.x, r.x+r.width};
+        row.push_back(run);
+    }
+    for(int y=0; y<size.height; y++)
+        M.addRow((y>=r.y && y<r.y+r.height) ? row : none);
+    return M;
+}
+
+RunMask RunMask::fromImage(const Image<uchar>& I){
+    RunMask M(I.size());
+    vector<Run> row;
+    for(int y=0; y<I.height(); y++){
+        row.clear();
+        const uchar* p = I.ptr<uchar>(y);
+        for(int x=0; x<I.width(); ){
+            if(!p[x]){
+                x++;
+                continue;
+            }
+            Run run = {x, x};
+            while(x<I.width() && p[x])
+                x++;
+            run.x1 = x;
+            row.push_back(run);
+        }
+        M.addRow(row);
+    }
+    return M;
+}
+
+// Each row is crossed by the border of a convex polygon in one interval, from the leftmost to the rightmost crossing
+// of its edges.
+RunMask RunMask::convexPolygon(Size size, const vector<Point2d>& P){
+    RunMask M(size);
+    const double eps = 1e-9;
+    vector<Run> row;
+    for(int y=0; y<size.height; y++){
+        row.clear();
+        double x0 = numeric_limits<double>::max(), x1 = -numeric_limits<double>::max();
+        for(size_t k=0; k<P.size(); k++){
+            const Point2d& a = P[k];
+            const Point2d& b = P[(k+1)%P.size()];
+            if(y<min(a.y, b.y)-eps || y>max(a.y, b.y)+eps)
+                continue;
+            if(fabs(b.y-a.y)<eps){
+                x0 = min(x0, min(a.x, b.x));
+                x1 = max(x1, max(a.x, b.x));
+                continue;
+            }
+            double x = a.x+(y-a.y)*(b.x-a.x)/(b.y-a.y);
+            x0 = min(x0, x);
+            x1 = max(x1, x);
+        }
+        if(x0<=x1){
+            Run run = {max((int)ceil(x0-eps), 0), min((int)floor(x1+eps)+1, size.width)};
+            if(run.x0<run.x1)
+                row.push_back(run);
+        }
+        M.addRow(row);
+    }
+    return M;
+}
+
+Rect RunMask::boundingRect() const {
+    int x0 = w, x1 = 0, y0 = h, y1 = 0;
+    for(int y=0; y<h; y++){
+        if(runs(y)==0)
+            continue;
+        x0 = min(x0, run(y,0).x0);
+        x1 = max(x1, run(y,runs(y)-1).x1);
+        y0 = min(y0, y);
+        y1 = y+1;
+    }
+    if(y1==0)
+        return Rect();
+    return Rect(x0, y0, x1-x0, y1-y0);
+}
+
+int RunMask::index(int x, int y) const {
+    if(y<0 || y>=h)
+        return -1;
+    // last run of the row starting at or before x
+    const Run* begin = run_list.data()+row_first[y];
+    const Run* end = run_list.data()+row_first[y+1];
+    const Run* r = upper_bound(begin, end, x, [](int v, const Run& run) { return v<run.x0; });
+    if(r==begin || x>=(r-1)->x1)
+        return -1;
+    r--;
+    return rank[r-run_list.data()]+x-r->x0;
+}
+
+// The boundaries of the runs of both rows, merged, cut the row in intervals inside or outside each mask; op tells
+// whether an interval is in the result, and neighbouring intervals of the result are joined.
+template <typename Op> RunMask RunMask::combine(const RunMask& M, Op op) const {
+    RunMask R(size());
+    vector<int> xs;
+    vector<Run> row;
+    for(int y=0; y<h; y++){
+        xs.clear();
+        row.clear();
+        for(int k=0; k<runs(y); k++){
+            xs.push_back(run(y,k).x0);
+            xs.push_back(run(y,k).x1);
+        }
+        size_t middle = xs.size();
+        for(int k=0; k<M.runs(y); k++){
+            xs.push_back(M.run(y,k).x0);
+            xs.push_back(M.run(y,k).x1);
+        }
+        inplace_merge(xs.begin(), xs.begin()+middle, xs.end());
+        xs.erase(unique(xs.begin(), xs.end()), xs.end());
+        int a = 0, b = 0;
+        for(size_t i=0; i+1<xs.size(); i++){
+            int x = xs[i];
+            while(a<runs(y) && run(y,a).x1<=x) a++;
+            while(b<M.runs(y) && M.run(y,b).x1<=x) b++;
+            bool in_a = a<runs(y) && run(y,a).x0<=x;
+            bool in_b = b<M.runs(y) && M.run(y,b).x0<=x;
+            if(!op(in_a, in_b))
+                continue;
+            if(!row.empty() && row.back().x1==x)
+                row.back().x1 = xs[i+1];
+            else{
+                Run run = {x, xs[i+1]};
+                row.push_back(run);
+            }
+        }
+        R.addRow(row);
+    }
+    return R;
+}
+
+RunMask RunMask::operator&(const RunMask& M) const {
+    return combine(M, [](bool a, bool b) { return a && b; });
+}
+
+RunMask RunMask::operator|(const RunMask& M) const {
+    return combine(M, [](bool a, bool b) { return a || b; });
+}
+
+RunMask RunMask::operator-(const RunMask& M) const {
+    return combine(M, [](bool a, bool b) { return a && !b; });
+}
+
+// sorts the runs and joins the ones that overlap or touch
+static void joinRuns(vector<RunMask::Run>& row){
+    sort(row.begin(), row.end(), [](const RunMask::Run& a, const RunMask::Run& b) { return a.x0<b.x0; });
+    size_t n = 0;
+    for(size_t k=0; k<row.size(); k++){
+        if(n>0 && row[k].x0<=row[n-1].x1)
+            row[n-1].x1 = max(row[n-1].x1, row[k].x1);
+        else
+            row[n++] = row[k];
+    }
+    row.resize(n);
+}
+
+RunMask RunMask::dilate(int r) const {
+    if(r<=0)
+        return *this;
+    // widened runs of each row, then for each row the union of the rows closer than r
+    vector<vector<Run> > wide(h);
+    for(int y=0; y<h; y++){
+        for(int k=0; k<runs(y); k++){
+            Run run = {max(this->run(y,k).x0-r, 0), min(this->run(y,k).x1+r, w)};
+            wide[y].push_back(run);
+        }
+        joinRuns(wide[y]);
+    }
+    RunMask R(size());
+    vector<Run> row;
+    for(int y=0; y<h; y++){
+        row.clear();
+        for(int j=max(y-r, 0); j<min(y+r+1, h); j++)
+            row.insert(row.end(), wide[j].begin(), wide[j].end());
+        joinRuns(row);
+        R.addRow(row);
+    }
+    return R;
+}
+
+Image<uchar> RunMask::toImage() const {
+    Image<uchar> I(w, h, CV_8U);
+    I.setTo(0);
+    for(int y=0; y<h; y++)
+        for(int k=0; k<runs(y); k++)
+            for(int x=run(y,k).x0; x<run(y,k).x1; x++)
+                I(x,y) = 255;
+    return I;
+}
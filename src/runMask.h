@@ -0,0 +1,69 @@
+#pragma once
+
+#include "image.h"
+#include <vector>
+
+// Set of points of a canvas of size() stored as runs of consecutive points of each row, so that a mask costs in
+// proportion to the length of its border rather than to its area: the footprint of an image on the canvas, rotated or
+// warped or not, is a few runs per row.
+// The points are ranked row by row, left to right; index() gives the rank of a point, which numbers the nodes of a
+// graph over the mask without an image of the size of the canvas.
+class RunMask {
+public:
+    // points x0 to x1-1 of a row
+    struct Run {
+        int x0, x1;
+    };
+
+    RunMask() : w(0), h(0) {}
+    // empty mask
+    RunMask(Size size);
+    // points of the rectangle r, clipped to the canvas
+    static RunMask rectangle(Size size, Rect r);
+    // non-zero points of the 8 bits image M
+    static RunMask fromImage(const Image<uchar>& M);
+    // points inside the convex polygon P or on its border, clipped to the canvas
+    static RunMask convexPolygon(Size size, const std::vector<Point2d>& P);
+
+    Size size() const { return Size(w, h); }
+    int width() const { return w; }
+    int height() const { return h; }
+    // number of points
+    int area() const { return rank.empty() ? 0 : rank.back(); }
+    bool empty() const { return area()==0; }
+    // smallest rectangle containing the points
+    Rect boundingRect() const;
+
+    // runs of row y are run(y,0) to run(y,runs(y)-1), from left to right
+    int runs(int y) const { return row_first[y+1]-row_first[y]; }
+    const Run& run(int y, int k) const { return run_list[row_first[y]+k]; }
+    // rank of the first point of run(y,k)
+    int runRank(int y, int k) const { return rank[row_first[y]+k]; }
+
+    bool contains(int x, int y) const { return index(x, y)>=0; }
+    bool contains(Point p) const { return contains(p.x, p.y); }
+    // rank of the point (x,y), or -1 if it is not in the mask
+    int index(int x, int y) const;
+    int index(Point p) const { return index(p.x, p.y); }
+
+    // intersection, union and difference of masks of the same canvas
+    RunMask operator&(const RunMask& M) const;
+    RunMask operator|(const RunMask& M) const;
+    RunMask operator-(const RunMask& M) const;
+    // points closer than r to the mask along each axis (dilation by a square of side 2r+1), clipped to the canvas
+    RunMask dilate(int r) const;
+    // image of the size of the canvas, 255 on the points of the mask
+    Image<uchar> toImage() const;
+
+    // Appends the next row, whose runs must be sorted and disjoint: a mask built with RunMask(size) receives its
+    // height() rows from top to bottom.
+    void addRow(const std::vector<Run>& row);
+
+private:
+    int w, h;
+    std::vector<Run> run_list;
+    std::vector<int> row_first; // runs of row y are run_list[row_first[y]] to run_list[row_first[y+1]-1]
+    std::vector<int> rank;      // rank[k] is the rank of the first point of run_list[k], rank.back() the area
+
+    template <typename Op> RunMask combine(const RunMask& M, Op op) const;
+};
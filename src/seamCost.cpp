@@ -0,0 +1,98 @@
+#include "seamCost.h"
+
+#include <cmath>
+
+// The vector kernels are compiled for their instruction set with target attributes and picked at run time,
+// so the rest of the library does not need to be built with -mavx2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEAMCOST_X86
+#include <immintrin.h>
+#endif
+
+void seamCostRowScalar(const Vec3b* bgr1, const Vec3b* bgr2, const float* g1, const float* g2, float wc, float wg, float* cost, int n){
+    for(int i=0; i<n; i++){
+        float d0 = float(bgr1[i][0])-bgr2[i][0];
+        float d1 = float(bgr1[i][1])-bgr2[i][1];
+        float d2 = float(bgr1[i][2])-bgr2[i][2];
+        cost[i] = wc*std::sqrt(d0*d0+d1*d1+d2*d2) + wg*std::fabs(g1[i]-g2[i]);
+    }
+}
+
+#ifdef SEAMCOST_X86
+
+// 8 points per iteration: one gather of 32 bits per point brings its three channels
+__attribute__((target("avx2")))
+static void seamCostRowAVX2(const Vec3b* bgr1, const Vec3b* bgr2, const float* g1, const float* g2, float wc, float wg, float* cost, int n){
+    const __m256i index = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    const __m256 vwc = _mm256_set1_ps(wc), vwg = _mm256_set1_ps(wg), sign = _mm256_set1_ps(-0.0f);
+    int i=0;
+    // the gather of the last point reads one byte past it, so the last point of the row is left to the scalar loop
+    for(; i+8<n; i+=8){
+        __m256i a = _mm256_i32gather_epi32((const int*)(bgr1+i), index, 1);
+        __m256i b = _mm256_i32gather_epi32((const int*)(bgr2+i), index, 1);
+        __m256 d0 = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_and_si256(a, byte)), _mm256_cvtepi32_ps(_mm256_and_si256(b, byte)));
+        __m256 d1 = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(a, 8), byte)), _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(b, 8), byte)));
+        __m256 d2 = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(a, 16), byte)), _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(b, 16), byte)));
+        __m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d0, d0), _mm256_mul_ps(d1, d1)), _mm256_mul_ps(d2, d2));
+        __m256 g = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(g1+i), _mm256_loadu_ps(g2+i)));
+        _mm256_storeu_ps(cost+i, _mm256_add_ps(_mm256_mul_ps(vwc, _mm256_sqrt_ps(s)), _mm256_mul_ps(vwg, g)));
+    }
+    seamCostRowScalar(bgr1+i, bgr2+i, g1+i, g2+i, wc, wg, cost+i, n-i);
+}
+
+// 4 points per iteration: a byte shuffle spreads each channel of the 4 points over 32 bit lanes
+__attribute__((target("ssse3")))
+static void seamCostRowSSSE3(const Vec3b* bgr1, const Vec3b* bgr2, const float* g1, const float* g2, float wc, float wg, float* cost, int n){
+    const __m128i channel0 = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+    const __m128i channel1 = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+    const __m128i channel2 = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    const __m128 vwc = _mm_set1_ps(wc), vwg = _mm_set1_ps(wg), sign = _mm_set1_ps(-0.0f);
+    int i=0;
+    // the 16 byte loads cover 5 points and a third, so they stop 2 points before the end of the row
+    for(; i+6<=n; i+=4){
+        __m128i a = _mm_loadu_si128((const __m128i*)(bgr1+i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(bgr2+i));
+        __m128 d0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(a, channel0)), _mm_cvtepi32_ps(_mm_shuffle_epi8(b, channel0)));
+        __m128 d1 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(a, channel1)), _mm_cvtepi32_ps(_mm_shuffle_epi8(b, channel1)));
+        __m128 d2 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(a, channel2)), _mm_cvtepi32_ps(_mm_shuffle_epi8(b, channel2)));
+        __m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2));
+        __m128 g = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(g1+i), _mm_loadu_ps(g2+i)));
+        _mm_storeu_ps(cost+i, _mm_add_ps(_mm_mul_ps(vwc, _mm_sqrt_ps(s)), _mm_mul_ps(vwg, g)));
+    }
+    seamCostRowScalar(bgr1+i, bgr2+i, g1+i, g2+i, wc, wg, cost+i, n-i);
+}
+
+#endif
+
+typedef void (*SeamCostFunction)(const Vec3b*, const Vec3b*, const float*, const float*, float, float, float*, int);
+
+struct SeamCostDispatch {
+    SeamCostFunction function;
+    const char* name;
+    SeamCostDispatch() : function(seamCostRowScalar), name("scalar") {
+#ifdef SEAMCOST_X86
+        if(__builtin_cpu_supports("avx2")){
+            function = seamCostRowAVX2;
+            name = "avx2";
+        }
+        else if(__builtin_cpu_supports("ssse3")){
+            function = seamCostRowSSSE3;
+            name = "ssse3";
+        }
+#endif
+    }
+};
+
+static const SeamCostDispatch& dispatch(){
+    static SeamCostDispatch d;
+    return d;
+}
+
+void seamCostRow(const Vec3b* bgr1, const Vec3b* bgr2, const float* g1, const float* g2, float wc, float wg, float* cost, int n){
+    dispatch().function(bgr1, bgr2, g1, g2, wc, wg, cost, n);
+}
+
+const char* seamCostKernel(){
+    return dispatch().name;
+}
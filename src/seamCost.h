@@ -0,0 +1,15 @@
+#pragma once
+
+#include "image.h"
+
+// Seam cost of n consecutive points of two aligned rows:
+// cost[i] = wc*||bgr1[i]-bgr2[i]|| + wg*|g1[i]-g2[i]|
+// where wc and wg are the weights of the BGR and gradient distances given by lambda.
+// Uses AVX2 or SSSE3 when the processor has them, seamCostRowScalar otherwise.
+void seamCostRow(const Vec3b* bgr1, const Vec3b* bgr2, const float* g1, const float* g2, float wc, float wg, float* cost, int n);
+
+// reference implementation of seamCostRow
+void seamCostRowScalar(const Vec3b* bgr1, const Vec3b* bgr2, const float* g1, const float* g2, float wc, float wg, float* cost, int n);
+
+// name of the implementation used by seamCostRow ("avx2", "ssse3" or "scalar")
+const char* seamCostKernel();
@@ -0,0 +1,134 @@
+// Checks of the maxflow solvers on random grids, against Graph::maxflow() on one thread, for the four capacity types
+// of maxflow/instances.inc: parallelMaxflow() and GridGraph must give the same flow, and their labels a cut of that
+// value.
+// Usage: ./MaxflowTests [seed], returns 0 when all the checks pass.
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <stdlib.h>
+
+#include "maxflow/graph.h"
+#include "parallel.h"
+#include "parallelGraph.h"
+#include "gridGraph.h"
+
+using namespace std;
+
+// random grid: capacities of the edges right and down of each point, and t-links, some of them large enough to pin
+// the point to a terminal as the fixed points of the overlap are
+struct RandomGrid {
+    int w, h;
+    vector<int> right, right_rev, down, down_rev, source, sink;
+
+    RandomGrid(int w, int h) : w(w), h(h), right(w*h), right_rev(w*h), down(w*h), down_rev(w*h), source(w*h), sink(w*h) {
+        for(int k=0; k<w*h; k++){
+            right[k] = rand()%100;
+            right_rev[k] = rand()%2 ? right[k] : rand()%100;
+            down[k] = rand()%100;
+            down_rev[k] = rand()%2 ? down[k] : rand()%100;
+            int r = rand()%20;
+            source[k] = (r==0) ? 10000 : (r<5 ? rand()%50 : 0);
+            sink[k] = (r==1) ? 10000 : (r>=5 && r<10 ? rand()%50 : 0);
+        }
+    }
+
+    // node(x,y) is the node of the point (x,y) in graph
+    template <class G, class Node> void addEdges(G& graph, Node node) const {
+        for(int y=0; y<h; y++)
+            for(int x=0; x<w; x++){
+                int k = x+y*w;
+                if(x<w-1) graph.add_edge(node(x,y), node(x+1,y), right[k], right_rev[k]);
+                if(y<h-1) graph.add_edge(node(x,y), node(x,y+1), down[k], down_rev[k]);
+                graph.add_tweights(node(x,y), source[k], sink[k]);
+            }
+    }
+
+    // value of the cut given by the labels (true for the source side)
+    double cutCost(const vector<bool>& source_side) const {
+        double cost = 0;
+        for(int y=0; y<h; y++)
+            for(int x=0; x<w; x++){
+                int k = x+y*w;
+                bool s = source_side[k];
+                cost += s ? sink[k] : source[k];
+                if(x<w-1 && s!=source_side[k+1]) cost += s ? right[k] : right_rev[k];
+                if(y<h-1 && s!=source_side[k+w]) cost += s ? down[k] : down_rev[k];
+            }
+        return cost;
+    }
+};
+
+// integer capacities must give exactly the same flow, floating point ones up to the rounding of the sums
+template <typename flowtype> static bool same(double a, double b){
+    if(numeric_limits<flowtype>::is_integer)
+        return a==b;
+    return fabs(a-b)<=1e-5*max(1.0, fabs(a));
+}
+
+static int failures = 0;
+
+static void check(bool ok, const string& what){
+    if(!ok){
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+static void checkParallelMaxflow(const RandomGrid& grid, const string& name){
+    typedef Graph<captype,tcaptype,flowtype> GraphType;
+    int n = grid.w*grid.h;
+    GraphType G(n, 2*n), P(n, 2*n);
+    G.add_node(n);
+    P.add_node(n);
+    auto node = [&](int x, int y) { return x+y*grid.w; };
+    grid.addEdges(G, node);
+    grid.addEdges(P, node);
+    double flow = G.maxflow(), parallel_flow = parallelMaxflow(P);
+    vector<bool> labels(n);
+    for(int k=0; k<n; k++)
+        labels[k] = P.what_segment(k)==GraphType::SOURCE;
+    check(same<flowtype>(flow, parallel_flow), "parallelMaxflow flow, " + name);
+    check(same<flowtype>(flow, grid.cutCost(labels)), "parallelMaxflow cut, " + name);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+static void checkGridGraph(const RandomGrid& grid, const string& name){
+    typedef Graph<captype,tcaptype,flowtype> GraphType;
+    typedef GridGraph<captype,tcaptype,flowtype> GridType;
+    int n = grid.w*grid.h;
+    GraphType G(n, 2*n);
+    G.add_node(n);
+    grid.addEdges(G, [&](int x, int y) { return x+y*grid.w; });
+    GridType R(grid.w, grid.h);
+    grid.addEdges(R, [&](int x, int y) { return R.node(x,y); });
+    double flow = G.maxflow(), grid_flow = R.maxflow();
+    vector<bool> labels(n);
+    for(int y=0; y<grid.h; y++)
+        for(int x=0; x<grid.w; x++)
+            labels[x+y*grid.w] = R.what_segment(R.node(x,y))==GridType::SOURCE;
+    check(same<flowtype>(flow, grid_flow), "GridGraph flow, " + name);
+    check(same<flowtype>(flow, grid.cutCost(labels)), "GridGraph cut, " + name);
+}
+
+int main(int argc, char** argv){
+    srand(argc>1 ? atoi(argv[1]) : 1);
+    // several blocks even on a machine with few cores
+    setParallelThreads(4);
+    for(int t=0; t<20; t++){
+        RandomGrid grid(5+rand()%60, 5+rand()%60);
+        checkParallelMaxflow<double,double,double>(grid, "double");
+        checkParallelMaxflow<float,float,float>(grid, "float");
+        checkParallelMaxflow<int,int,int>(grid, "int");
+        checkParallelMaxflow<short,int,int>(grid, "short");
+        checkGridGraph<double,double,double>(grid, "double");
+        checkGridGraph<float,float,float>(grid, "float");
+        checkGridGraph<int,int,int>(grid, "int");
+        checkGridGraph<short,int,int>(grid, "short");
+    }
+    if(failures)
+        cout << failures << " checks failed" << endl;
+    else
+        cout << "all checks passed" << endl;
+    return failures ? 1 : 0;
+}
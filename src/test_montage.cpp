@@ -0,0 +1,142 @@
+// Checks of the montage of two images on random images, for the four capacity types: the grid and parallel solvers
+// must give the same flow as Graph::maxflow() on the same costs and constraints (the points closer than delta to the
+// border of the overlap pinned to their image), also when the grid graph is built by several threads. IncrementalMontage must give the cost of a new photomontage() after
+// any sequence of changes of lambda and delta.
+// Usage: ./MontageTests [seed], returns 0 when all the checks pass.
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <cmath>
+#include <stdlib.h>
+
+#include "photomontage.h"
+#include "incrementalMontage.h"
+#include "parallel.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string& what){
+    if(!ok){
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+// integer capacities must give exactly the same flow, floating point ones up to the rounding of the sums
+static bool same(double a, double b, int capacity){
+    if(capacity==CAPACITY_INT || capacity==CAPACITY_SHORT)
+        return a==b;
+    return fabs(a-b)<=1e-5*max(1.0, fabs(a));
+}
+
+// random colors, blurred so that the seam costs vary smoothly as in photographs
+static Image<Vec3b> randomImage(int w, int h){
+    Image<Vec3b> I(w, h, CV_8UC3);
+    randu(I, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(I, I, Size(7,7), 0);
+    return I;
+}
+
+static void checkSolvers(){
+    const char* capacities[4] = {"double", "float", "int", "short"};
+    const char* solvers[3] = {"bk", "parallel", "grid"};
+    for(int t=0; t<6; t++){
+        int w = 80+rand()%60, h = 60+rand()%60;
+        Image<Vec3b> I1 = randomImage(w, h), I2 = randomImage(w, h);
+        MontageParams params;
+        params.type = 1+t%2;
+        params.delta = 1+rand()%6;
+        params.lambda = rand()%(params.max_lambda+1);
+        Point offset1(0, 0), offset2 = (params.type==1) ? Point(w/2+rand()%(w/4), rand()%8) : Point(rand()%8, h/2+rand()%(h/4));
+        for(int c=0; c<4; c++){
+            params.capacity = c;
+            double flow[3];
+            for(int s=0; s<3; s++){
+                params.solver = s;
+                Image<Vec3b> montage;
+                Image<float> cut;
+                flow[s] = photomontage(I1, I2, offset1, offset2, montage, cut, params);
+            }
+            check(flow[SOLVER_BK]>0, string("bk flow, ") + capacities[c]);
+            for(int s=1; s<3; s++)
+                check(same(flow[SOLVER_BK], flow[s], c), string(solvers[s]) + " flow against bk, " + capacities[c]);
+        }
+    }
+}
+
+// the grid graph built by bands of rows on 8 threads, several times, against Graph::maxflow() built on one thread
+template <typename captype, typename tcaptype, typename flowtype>
+static void checkGridThreads(const Rectangle& overlap, const Image<uchar>& constraints, const Image<float>& horizontal, const Image<float>& vertical, int capacity, const string& name){
+    double scale = capacityScale<captype>(16);
+    Image<int> nodes;
+    int node_num = numberFreePoints(constraints, nodes);
+    setParallelThreads(1);
+    Graph<captype,tcaptype,flowtype> G = createGraphFromRectangle<captype,tcaptype,flowtype>(overlap, constraints, nodes, node_num, horizontal, vertical, scale);
+    double flow_bk = G.maxflow();
+    setParallelThreads(8);
+    for(int r=0; r<3; r++){
+        GridGraph<captype,tcaptype,flowtype> R = createGridGraphFromRectangle<captype,tcaptype,flowtype>(overlap, constraints, horizontal, vertical, scale);
+        check(same(flow_bk, R.maxflow(), capacity), "grid graph built on 8 threads against bk, " + name);
+    }
+    setParallelThreads(4);
+}
+
+static void checkGridBuild(){
+    for(int t=0; t<4; t++){
+        int w = 60+rand()%60, h = 80+rand()%60;
+        Image<Vec3b> I1 = randomImage(w, h), I2 = randomImage(w, h);
+        Image<float> G1(w, h, CV_32F), G2(w, h, CV_32F);
+        computeGradient(I1, G1, false);
+        computeGradient(I2, G2, false);
+        Rectangle overlap;
+        overlap.p1 = Point(0, 0);
+        overlap.p2 = Point(w, h);
+        Image<float> horizontal, vertical;
+        computeSeamCosts(overlap, I1, I2, G1, G2, Point(0, 0), Point(0, 0), rand()%11, 10, horizontal, vertical);
+        Image<uchar> constraints = overlapConstraints(overlap, true, true, 1+t%2, 1+rand()%6);
+        checkGridThreads<double,double,double>(overlap, constraints, horizontal, vertical, CAPACITY_DOUBLE, "double");
+        checkGridThreads<float,float,float>(overlap, constraints, horizontal, vertical, CAPACITY_FLOAT, "float");
+        checkGridThreads<int,int,int>(overlap, constraints, horizontal, vertical, CAPACITY_INT, "int");
+        checkGridThreads<short,int,int>(overlap, constraints, horizontal, vertical, CAPACITY_SHORT, "short");
+    }
+}
+
+// the cost of the cut of each update, with the graph reused, against photomontage() solving it from scratch
+static void checkIncremental(){
+    for(int t=0; t<4; t++){
+        int w = 80+rand()%60, h = 60+rand()%60;
+        Image<Vec3b> I1 = randomImage(w, h), I2 = randomImage(w, h);
+        MontageParams params;
+        params.type = 1+t%2;
+        Point offset1(0, 0), offset2 = (params.type==1) ? Point(w/2+rand()%(w/4), rand()%8) : Point(rand()%8, h/2+rand()%(h/4));
+        IncrementalMontage incremental;
+        for(int k=0; k<12; k++){
+            // one of lambda, delta or both changes, so that each update path is taken
+            int change = rand()%3;
+            if(k==0 || change!=1)
+                params.lambda = rand()%(params.max_lambda+1);
+            if(k==0 || change!=0)
+                params.delta = 1+rand()%6;
+            Image<Vec3b> montage;
+            Image<float> cut;
+            double cost = incremental.update(I1, I2, offset1, offset2, montage, cut, params);
+            double flow = photomontage(I1, I2, offset1, offset2, montage, cut, params);
+            check(same(flow, cost, CAPACITY_DOUBLE), "incremental cut cost against photomontage()");
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    theRNG().state = argc>1 ? atoi(argv[1]) : 1;
+    srand(argc>1 ? atoi(argv[1]) : 1);
+    setParallelThreads(4);
+    checkSolvers();
+    checkGridBuild();
+    checkIncremental();
+    if(failures)
+        cout << failures << " checks failed" << endl;
+    else
+        cout << "all checks passed" << endl;
+    return failures ? 1 : 0;
+}
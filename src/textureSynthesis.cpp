@@ -0,0 +1,149 @@
+#include "textureSynthesis.h"
+#include "graphPool.h"
+
+#include <iostream>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// the output being synthesized: each filled point comes from a patch, which is the sample placed at an offset
+struct TextureCanvas {
+    const Image<Vec3b>& sample;
+    Image<Vec3b> output;
+    Image<int> patch;       // patch of each point, -1 if not filled yet
+    vector<Point> offsets;  // point p of patch k is the point p-offsets[k] of the sample
+
+    TextureCanvas(const Image<Vec3b>& sample, Size size) : sample(sample), output(size.width, size.height, DataType<Vec3b>::type), patch(size.width, size.height, CV_32S) {
+        output.setTo(Scalar(0,0,0));
+        patch.setTo(-1);
+    }
+    bool inside(Point p) const { return p.x>=0 && p.y>=0 && p.x<output.width() && p.y<output.height(); }
+    // color of patch k at p, the color of the output if the sample does not cover p
+    Vec3f color(int k, Point p) const {
+        Point q = p-offsets[k];
+        if(q.x<0 || q.y<0 || q.x>=sample.width() || q.y>=sample.height())
+            return Vec3f(output(p));
+        return Vec3f(sample(q));
+    }
+    // cost of a seam between patches a (or the output if a<0) and b at the points s and t
+    double seamCost(Point s, Point t, int a, int b) const {
+        Vec3f as = a<0 ? Vec3f(output(s)) : color(a,s), at = a<0 ? Vec3f(output(t)) : color(a,t);
+        return norm(as-color(b,s))+norm(at-color(b,t));
+    }
+};
+
+}
+
+// place of the patch r in the sample: the masked SSD with the filled points of r, drawn among the near-best ones
+static Point choosePatch(const TextureCanvas& canvas, const Rect& r, double tolerance, RNG& rng){
+    const Image<Vec3b>& sample = canvas.sample;
+    Mat filled = Mat(canvas.patch, r)>=0;
+    if(countNonZero(filled)==0)
+        return Point(rng.uniform(0, sample.width()-r.width+1), rng.uniform(0, sample.height()-r.height+1));
+    Mat mask, mask3;
+    filled.convertTo(mask, CV_8U, 1./255);
+    Mat planes[] = {mask, mask, mask};
+    merge(planes, 3, mask3);
+    Image<float> ssd;
+    matchTemplate(sample, Mat(canvas.output, r), ssd, TM_SQDIFF, mask3);
+    double best;
+    minMaxLoc(ssd, &best);
+    vector<Point> near;
+    for(int y=0; y<ssd.height(); y++)
+        for(int x=0; x<ssd.width(); x++)
+            if(ssd(x,y)<=best*(1+tolerance)+1e-6)
+                near.push_back(Point(x,y));
+    return near[rng.uniform(0, (int)near.size())];
+}
+
+// places patch k on r: a cut between the old colors (SOURCE) and the patch (SINK) over the filled points of r
+static void placePatch(TextureCanvas& canvas, const Rect& r, int k){
+    Image<int> nodes(r.width, r.height, CV_32S);
+    int node_num = 0;
+    for(int y=0; y<r.height; y++)
+        for(int x=0; x<r.width; x++)
+            nodes(x,y) = canvas.patch(r.x+x, r.y+y)>=0 ? node_num++ : -1;
+
+    if(node_num>0){
+        // a seam node per old seam at most, as many as the edges
+        GraphPool<double,double,double>::GraphPtr G = graphPool<double,double,double>().acquire(3*node_num, 6*node_num);
+        G->add_node(node_num);
+        // every edge with an end in r, from its left or upper end
+        for(int y=r.y-1; y<r.y+r.height; y++)
+            for(int x=r.x-1; x<r.x+r.width; x++)
+                for(int d=0; d<2; d++){
+                    Point s(x,y), t = (d==0) ? Point(x+1,y) : Point(x,y+1);
+                    if(!canvas.inside(s) || !canvas.inside(t))
+                        continue;
+                    bool s_in = r.contains(s), t_in = r.contains(t);
+                    if(!s_in && !t_in)
+                        continue;
+                    int a = canvas.patch(s), b = canvas.patch(t);
+                    int i = s_in ? nodes(x-r.x, y-r.y) : -1, j = t_in ? nodes(t.x-r.x, t.y-r.y) : -1;
+                    if(i>=0 && j>=0){
+                        if(a==b){
+                            double c = canvas.seamCost(s, t, a, k);
+                            G->add_edge(i, j, c, c);
+                        }
+                        else{
+                            // old seam: cut between s and the seam node if s keeps a and t takes k, between the
+                            // seam node and t if s takes k and t keeps b, and its t-link if both keep their colors
+                            int e = G->add_node();
+                            double cs = canvas.seamCost(s, t, a, k), ct = canvas.seamCost(s, t, k, b);
+                            G->add_edge(i, e, cs, cs);
+                            G->add_edge(e, j, ct, ct);
+                            G->add_tweights(e, 0, canvas.seamCost(s, t, a, b));
+                        }
+                    }
+                    else if(i>=0 || j>=0){
+                        // the other end is either a new point of r, which takes k, or a filled point outside r
+                        int n = (i>=0) ? i : j, other = (i>=0) ? b : a;
+                        bool other_in = (i>=0) ? t_in : s_in;
+                        int own = (i>=0) ? a : b;
+                        if(other_in)
+                            G->add_tweights(n, 0, canvas.seamCost(s, t, own, k));
+                        else if(other>=0)
+                            G->add_tweights(n, canvas.seamCost(s, t, other, k), canvas.seamCost(s, t, other, own));
+                    }
+                }
+        G->maxflow();
+        for(int y=0; y<r.height; y++)
+            for(int x=0; x<r.width; x++)
+                if(nodes(x,y)>=0 && G->what_segment(nodes(x,y))==Graph<double,double,double>::SOURCE)
+                    nodes(x,y) = -2; // keeps its color
+    }
+
+    for(int y=0; y<r.height; y++)
+        for(int x=0; x<r.width; x++)
+            if(nodes(x,y)!=-2){
+                Point p(r.x+x, r.y+y);
+                canvas.patch(p) = k;
+                canvas.output(p) = canvas.sample(p-canvas.offsets[k]);
+            }
+}
+
+bool synthesizeTexture(const Image<Vec3b>& sample, Size size, Image<Vec3b>& output, const TextureParams& params){
+    int patch = params.patch, step = params.patch-params.overlap;
+    if(patch>sample.width() || patch>sample.height() || step<=0){
+        cout << "the patches must fit in the sample and be larger than their overlap" << endl;
+        return false;
+    }
+    TextureCanvas canvas(sample, size);
+    RNG rng(params.seed);
+    for(int y0=0; y0<size.height; y0+=step){
+        for(int x0=0; x0<size.width; x0+=step){
+            Rect r = Rect(x0, y0, patch, patch) & Rect(0, 0, size.width, size.height);
+            Point q = choosePatch(canvas, r, params.tolerance, rng);
+            canvas.offsets.push_back(r.tl()-q);
+            placePatch(canvas, r, (int)canvas.offsets.size()-1);
+            if(x0+patch>=size.width)
+                break;
+        }
+        if(y0+patch>=size.height)
+            break;
+    }
+    output = canvas.output;
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "image.h"
+
+// Parameters of the texture synthesis
+// patch: size of the square blocks of the sample placed on the output
+// overlap: points shared by a patch with the patches placed before it, on its left and above
+// tolerance: the sample position of a patch is drawn among those whose SSD over the overlap is at most (1+tolerance)
+// times the best one
+// seed: seed of the random choices
+struct TextureParams {
+    int patch;
+    int overlap;
+    double tolerance;
+    unsigned seed;
+    TextureParams() : patch(96), overlap(24), tolerance(0.1), seed(0) {}
+};
+
+// Graphcut Textures synthesis (Kwatra et al. 2003) of an output of the given size from a sample.
+// Patches of the sample are placed row by row, every patch-overlap points. The position of each patch in the sample
+// is chosen by matchTemplate (TM_SQDIFF, masked to the points of the output already filled). The points where
+// the patch overlaps the output then take the old or the new color through a min-cut on Graph. The cost of an edge
+// (s,t) between patches A and B is ||A(s)-B(s)||+||A(t)-B(t)||. The output keeps the patch of each point. Where two
+// neighbours come from different patches, the graph gets a seam node for the old seam, so the new patch can replace
+// it, keep it or cut across it.
+// Returns false if the sample is smaller than a patch.
+bool synthesizeTexture(const Image<Vec3b>& sample, Size size, Image<Vec3b>& output, const TextureParams& params = TextureParams());
@@ -0,0 +1,206 @@
+#include "tiledMontage.h"
+#include "imageStream.h"
+#include "parallelGraph.h"
+#include "graphPool.h"
+
+#include <iostream>
+
+using namespace std;
+
+// lines [a,b) of the overlap along the seam
+static Rectangle stripRectangle(const Rectangle& overlap, int type, int a, int b){
+    Rectangle r = overlap;
+    if(type==1){
+        r.p1.y = overlap.p1.y+a;
+        r.p2.y = overlap.p1.y+b;
+    }
+    else{
+        r.p1.x = overlap.p1.x+a;
+        r.p2.x = overlap.p1.x+b;
+    }
+    return r;
+}
+
+// reads the part of the image placed at offset that covers the rectangle r of the montage, with margin more points
+// on each side where the image has them. tile_offset receives the place of the tile in the montage.
+static bool readTile(PPMReader& reader, Point offset, const Rectangle& r, int margin, Image<Vec3b>& tile, Point& tile_offset){
+    Rect rect(r.p1.x-offset.x-margin, r.p1.y-offset.y-margin, r.p2.x-r.p1.x+2*margin, r.p2.y-r.p1.y+2*margin);
+    rect &= Rect(0, 0, reader.width(), reader.height());
+    tile_offset = offset + rect.tl();
+    return reader.read(rect, tile);
+}
+
+// cut of the region of the overlap, first receives 1 for the points that come from the first image
+template <typename captype, typename tcaptype, typename flowtype>
+static void solveStrip(const Rectangle& region, const Image<uchar>& constraints, const Image<float>& horizontal, const Image<float>& vertical, const MontageParams& params, Image<uchar>& first){
+    double scale = capacityScale<captype>(params.capacity_scale);
+    if(params.solver==SOLVER_GRID){
+        GridGraph<captype,tcaptype,flowtype> G = createGridGraphFromRectangle<captype,tcaptype,flowtype>(region, constraints, horizontal, vertical, scale);
+        G.maxflow();
+        for(int y=0; y<constraints.height(); y++)
+            for(int x=0; x<constraints.width(); x++){
+                if(constraints(x,y)==POINT_FREE)
+                    first(x,y) = G.what_segment(G.node(x,y))==GridGraph<captype,tcaptype,flowtype>::SOURCE;
+                else
+                    first(x,y) = constraints(x,y)==POINT_FIRST_IMAGE;
+            }
+        return;
+    }
+    Image<int> nodes;
+    int node_num = numberFreePoints(constraints, nodes);
+    // the strips have about the same size, they reuse the same graph
+    typename GraphPool<captype,tcaptype,flowtype>::GraphPtr G = graphPool<captype,tcaptype,flowtype>().acquire(node_num, 2*node_num);
+    buildGraphFromRectangle(*G, region, constraints, nodes, node_num, horizontal, vertical, scale);
+    if(params.solver==SOLVER_PARALLEL)
+        parallelMaxflow(*G);
+    else
+        G->maxflow();
+    for(int y=0; y<constraints.height(); y++)
+        for(int x=0; x<constraints.width(); x++){
+            if(constraints(x,y)==POINT_FREE)
+                first(x,y) = G->what_segment(nodes(x,y))==Graph<captype,tcaptype,flowtype>::SOURCE;
+            else
+                first(x,y) = constraints(x,y)==POINT_FIRST_IMAGE;
+        }
+}
+
+double tiledPhotomontage(const string& image1, const string& image2, Point offset1, Point offset2, const string& montage, const string& cut, const MontageParams& params, int strip, int halo, LabelMapWriter* label_map){
+    PPMReader reader1, reader2;
+    if(!reader1.open(image1) || !reader2.open(image2))
+        return -1;
+    bool right_order1=true, right_order2=true;
+    Rectangle rec, overlap;
+    if(!selectRectangles(rectangleOverlap(reader1.size(), reader2.size(), offset1, offset2, right_order1, right_order2), rec, overlap, params.type))
+        return -1;
+    if(overlap.p2.x<=overlap.p1.x || overlap.p2.y<=overlap.p1.y){
+        cout << "the images do not overlap" << endl;
+        return -1;
+    }
+    strip = max(strip, 1);
+    // the edges between a strip and the previous one are counted in the halo
+    halo = max(halo, 1);
+
+    int w = overlap.p2.x-overlap.p1.x, h = overlap.p2.y-overlap.p1.y;
+    int length = (params.type==1) ? h : w;
+    // labels of the finished lines of the overlap, 1 where the point comes from the first image, spooled next to the cut
+    ByteSpool labels;
+    if(!labels.open(cut + ".labels", w))
+        return -1;
+    // labels of the previous strip with its halo, for the constraints of the next one
+    Image<uchar> previous;
+    Point previous_d;
+    double cost = 0;
+    for(int s0=0; s0<length; s0+=strip){
+        int s1 = min(s0+strip, length), a = max(s0-halo, 0), b = min(s1+halo, length);
+        Rectangle region = stripRectangle(overlap, params.type, a, b);
+        int rw = region.p2.x-region.p1.x, rh = region.p2.y-region.p1.y;
+        Point d = region.p1-overlap.p1;
+
+        // the gradient of a point depends on its neighbours up to 2 points away (blur and Sobel)
+        Image<Vec3b> T1, T2;
+        Point t1, t2;
+        if(!readTile(reader1, offset1, region, 2, T1, t1) || !readTile(reader2, offset2, region, 2, T2, t2))
+            return -1;
+        Image<float> G1(T1.width(), T1.height(), CV_32F), G2(T2.width(), T2.height(), CV_32F);
+        computeGradient(T1, G1, params.blur_image);
+        computeGradient(T2, G2, params.blur_image);
+        Image<float> horizontal, vertical;
+        computeSeamCosts(region, T1, T2, G1, G2, t1, t2, params.lambda, params.max_lambda, horizontal, vertical);
+
+        // the strip spans the whole overlap across the seam, so the constraints of delta are the same as for the overlap.
+        // The previous strip starts before this one and its labels before s0 are final (solved or fixed).
+        Image<uchar> constraints = overlapConstraints(region, right_order1, right_order2, params.type, params.delta);
+        for(int y=0; y<rh; y++)
+            for(int x=0; x<rw; x++){
+                int line = (params.type==1) ? y+d.y : x+d.x;
+                if(line<s0)
+                    constraints(x,y) = previous(x+d.x-previous_d.x,y+d.y-previous_d.y) ? POINT_FIRST_IMAGE : POINT_SECOND_IMAGE;
+            }
+        Image<uchar> first(rw, rh, CV_8U);
+        switch(params.capacity){
+        case CAPACITY_FLOAT:
+            solveStrip<float,float,float>(region, constraints, horizontal, vertical, params, first);
+            break;
+        case CAPACITY_INT:
+            solveStrip<int,int,int>(region, constraints, horizontal, vertical, params, first);
+            break;
+        case CAPACITY_SHORT:
+            solveStrip<short,int,int>(region, constraints, horizontal, vertical, params, first);
+            break;
+        default:
+            solveStrip<double,double,double>(region, constraints, horizontal, vertical, params, first);
+        }
+
+        // counts the cut edges ending on the lines of the strip from the left or above, then spools their labels
+        for(int y=0; y<rh; y++)
+            for(int x=0; x<rw; x++){
+                int line = (params.type==1) ? y+d.y : x+d.x;
+                if(line<s0 || line>=s1)
+                    continue;
+                uchar l = first(x,y);
+                if(x>0 && first(x-1,y)!=l)
+                    cost += horizontal(x-1,y);
+                if(y>0 && first(x,y-1)!=l)
+                    cost += vertical(x,y-1);
+            }
+        for(int y=0; y<rh; y++){
+            int x0 = 0, x1 = rw;
+            if(params.type==1){
+                if(y+d.y<s0 || y+d.y>=s1)
+                    continue;
+            }
+            else{
+                x0 = s0-d.x;
+                x1 = s1-d.x;
+            }
+            if(!labels.write(x0+d.x, y+d.y, first.ptr<uchar>(y)+x0, x1-x0)){
+                cout << "could not write " << cut << ".labels" << endl;
+                return -1;
+            }
+        }
+        previous = first;
+        previous_d = d;
+    }
+
+    // the montage and the cut, row by row
+    int mw = rec.p2.x-rec.p1.x, mh = rec.p2.y-rec.p1.y;
+    PPMWriter montage_writer, cut_writer;
+    if(!montage_writer.open(montage, mw, mh, 3) || !cut_writer.open(cut, mw, mh, 1))
+        return -1;
+    if(label_map && !label_map->open(mw, mh, rec.p1))
+        return -1;
+    bool first_side = (params.type==1) ? right_order1 : right_order2;
+    Image<Vec3b> row(mw, 1, DataType<Vec3b>::type);
+    vector<uchar> cut_row(mw), label_row(w);
+    for(int j=rec.p1.y; j<rec.p2.y; j++){
+        Rectangle line = {Point(rec.p1.x, j), Point(rec.p2.x, j+1)};
+        Image<Vec3b> R1, R2;
+        Point r1, r2;
+        if(!readTile(reader1, offset1, line, 0, R1, r1) || !readTile(reader2, offset2, line, 0, R2, r2))
+            return -1;
+        if(j>=overlap.p1.y && j<overlap.p2.y && !labels.readRow(j-overlap.p1.y, &label_row[0])){
+            cout << "could not read " << cut << ".labels" << endl;
+            return -1;
+        }
+        for(int i=rec.p1.x; i<rec.p2.x; i++){
+            bool from_first;
+            if(i>=overlap.p1.x && i<overlap.p2.x && j>=overlap.p1.y && j<overlap.p2.y)
+                from_first = label_row[i-overlap.p1.x]!=0;
+            else if(i<overlap.p1.x || j<overlap.p1.y)
+                from_first = first_side;
+            else
+                from_first = !first_side;
+            row(i-rec.p1.x, 0) = from_first ? R1(i-r1.x, 0) : R2(i-r2.x, 0);
+            cut_row[i-rec.p1.x] = from_first ? 255 : 0;
+        }
+        if(!montage_writer.writeRow(row.ptr<Vec3b>(0)) || !cut_writer.writeRow(&cut_row[0])){
+            cout << "could not write " << montage << " or " << cut << endl;
+            return -1;
+        }
+        if(label_map && !label_map->writeRow(&cut_row[0]))
+            return -1;
+    }
+    if(label_map && !label_map->close())
+        return -1;
+    return cost;
+}
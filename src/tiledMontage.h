@@ -0,0 +1,17 @@
+#pragma once
+
+#include "photomontage.h"
+#include <string>
+
+// Montage of two images that do not fit in memory, read from and written to binary PPM files (see imageStream.h).
+// The overlap is cut in strips of strip lines along the seam (rows for type 1, columns for type 2). Each strip is read
+// with halo lines on both sides, its gradients and seam costs are computed on the strip only and its cut is solved
+// with the halo lines before it fixed to the labels of the previous strip, so that the seam goes on from one strip to
+// the next; the labels of the halo lines after it are dropped.
+// Only the labels of the current strip with its halo are kept in memory; the labels of the finished lines (one byte per
+// point) are spooled to the temporary file cut+".labels", from which the montage (P6) and the cut (P5, 255 where the
+// pixel comes from the first image) are then written row by row. Memory is O(length of the overlap across the seam x
+// (strip+2*halo)), the disk needs the area of the overlap for the time of the call.
+// The label map is also written to label_map, row by row, when it is not NULL.
+// params.pyramid_levels is not used. Returns the cost of the seam, or -1 on error.
+double tiledPhotomontage(const std::string& image1, const std::string& image2, Point offset1, Point offset2, const std::string& montage, const std::string& cut, const MontageParams& params = MontageParams(), int strip = 1024, int halo = 64, LabelMapWriter* label_map = NULL);